@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "ParallelAlgorithms.hpp"
+
+//
+//  Parallel algorithms against their single threaded std counterparts.
+//
+//      job_bench [elements...]    (default: 1000000 10000000 100000000)
+//
+
+template <typename Fn>
+static double bestOf(int runs, Fn&& fn) {
+  double best = 1e300;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+static void report(const char* name, size_t n, double baselineMs, double ms, bool valid) {
+  std::printf("  %-28s %10zu  %10.2f ms  %6.2fx%s\n", name, n, ms, baselineMs / ms, valid ? "" : "  MISMATCH");
+}
+
+int main(int argc, char** argv) {
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; ++i) {
+    sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+  }
+  if (sizes.empty()) {
+    sizes = {1'000'000, 10'000'000, 100'000'000};
+  }
+
+  // The calling thread helps, so leave it a core
+  size_t workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  JobSystem system(workers);
+  auto policy = parallel::par(system);
+  std::printf("%zu workers + caller\n", workers);
+
+  std::mt19937_64 rng(42);
+  int runs = 3;
+
+  for (size_t n : sizes) {
+    std::vector<uint32_t> input(n);
+    for (auto& value : input) value = static_cast<uint32_t>(rng());
+
+    std::vector<uint32_t> expected = input;
+    std::vector<uint32_t> work(n);
+
+    std::printf("\n%zu elements\n", n);
+
+    double stdSort = bestOf(runs, [&]() {
+      work = input;
+      std::sort(work.begin(), work.end());
+    });
+    expected = work;
+    report("std::sort", n, stdSort, stdSort, true);
+
+    double mergeSort = bestOf(runs, [&]() {
+      work = input;
+      parallel::sort(policy, work.begin(), work.end());
+    });
+    report("parallel::sort", n, stdSort, mergeSort, work == expected);
+
+    double radixSort = bestOf(runs, [&]() {
+      work = input;
+      parallel::radix_sort(policy, work.begin(), work.end());
+    });
+    report("parallel::radix_sort", n, stdSort, radixSort, work == expected);
+
+    std::vector<uint64_t> values(input.begin(), input.end());
+    std::vector<uint64_t> scanned(n);
+    std::vector<uint64_t> expectedScan(n);
+
+    double stdScan = bestOf(runs, [&]() { std::inclusive_scan(values.begin(), values.end(), expectedScan.begin()); });
+    report("std::inclusive_scan", n, stdScan, stdScan, true);
+
+    double scan = bestOf(runs, [&]() { parallel::inclusive_scan(policy, values.begin(), values.end(), scanned.begin()); });
+    report("parallel::inclusive_scan", n, stdScan, scan, scanned == expectedScan);
+
+    uint64_t expectedSum = 0;
+    double stdReduce = bestOf(runs, [&]() {
+      expectedSum = std::transform_reduce(values.begin(), values.end(), uint64_t(0), std::plus<>{}, [](uint64_t v) { return v & 0xFF; });
+    });
+    report("std::transform_reduce", n, stdReduce, stdReduce, true);
+
+    uint64_t sum = 0;
+    double reduce = bestOf(runs, [&]() {
+      sum = parallel::transform_reduce(policy, values.begin(), values.end(), uint64_t(0), std::plus<>{}, [](uint64_t v) { return v & 0xFF; });
+    });
+    report("parallel::transform_reduce", n, stdReduce, reduce, sum == expectedSum);
+  }
+
+  return 0;
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cassert>
 #include <cstddef>
 #include <span>
+#include <type_traits>
 #include <utility>
 
 #include "FrameArena.hpp"
@@ -41,12 +43,12 @@ class ArenaArray {
 
   void push_back(const T& value) {
     assert(_size < N && "ArenaArray capacity exceeded");
-    _storage[_size++] = value;
+    _data[_size++] = value;
   }
 
   void push_back(T&& value) {
     assert(_size < N && "ArenaArray capacity exceeded");
-    _storage[_size++] = std::move(value);
+    _data[_size++] = std::move(value);
   }
 
   T& operator[](size_t i) {
@@ -65,7 +67,7 @@ class ArenaArray {
   T* end() { return _data + _size; }
   const T* end() const { return _data + _size; }
 
-  std::span span() { return {_data, _size}; }
+  std::span<T> span() { return {_data, _size}; }
   const T* data() const { return _data; }
   size_t size() const { return _size; }
   constexpr size_t capacity() const { return N; }
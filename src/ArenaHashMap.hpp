@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "FrameArena.hpp"
+#include "Hash.hpp"
+
+//
+//  Default hash: integers and enums are mixed, other trivially copyable
+//  keys are hashed byte-wise (so they must not contain padding).
+//
+template <typename K>
+struct ArenaHash {
+  uint64_t operator()(const K& key) const {
+    if constexpr (std::is_integral_v<K> || std::is_enum_v<K> || std::is_pointer_v<K>) {
+      return hashMix(static_cast<uint64_t>((uintptr_t)key));
+    } else {
+      static_assert(std::has_unique_object_representations_v<K>, "Provide a hash for keys with padding or floats");
+      return hashBytes(&key, sizeof(K));
+    }
+  }
+};
+
+//
+//  Open addressing hash map with linear probing, allocated from a
+//  FrameArena. Keys and values sit next to each other in one flat array,
+//  so a lookup is usually a single cache line. Erase shifts the following
+//  entries back instead of leaving tombstones, so probe sequences stay
+//  short under churn.
+//
+//  Capacity is a power of two and the map grows at 7/8 load. Growing
+//  rehashes into a new block, the old one is lost until the arena is
+//  reset. Pointers to values are invalidated by inserts that grow and by
+//  erase. A default constructed map is empty (lookups miss) and has no
+//  arena to insert into until one is moved in.
+//
+template <typename K, typename V, typename Hash = ArenaHash<K>>
+class ArenaHashMap {
+ public:
+  static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_destructible_v<K>, "ArenaHashMap keys must be POD-like");
+  static_assert(std::is_trivially_copyable_v<V> && std::is_trivially_destructible_v<V>, "ArenaHashMap values must be POD-like");
+
+  struct Entry {
+    K key;
+    V value;
+  };
+
+  ArenaHashMap() = default;
+  ~ArenaHashMap() = default;
+
+  explicit ArenaHashMap(FrameArena* arena, size_t expectedSize = 16) : _arena(arena) {
+    rehash(capacityFor(expectedSize));
+  }
+
+  ArenaHashMap(const ArenaHashMap&) noexcept = delete;
+  ArenaHashMap& operator=(const ArenaHashMap&) noexcept = delete;
+
+  ArenaHashMap(ArenaHashMap&& other) noexcept
+      : _arena(other._arena), _entries(other._entries), _used(other._used), _size(other._size), _mask(other._mask) {
+    other._arena = nullptr;
+    other._entries = nullptr;
+    other._used = nullptr;
+    other._size = 0;
+    other._mask = 0;
+  }
+
+  ArenaHashMap& operator=(ArenaHashMap&& other) noexcept {
+    if (&other == this) {
+      return *this;
+    }
+
+    _arena = other._arena;
+    _entries = other._entries;
+    _used = other._used;
+    _size = other._size;
+    _mask = other._mask;
+
+    other._arena = nullptr;
+    other._entries = nullptr;
+    other._used = nullptr;
+    other._size = 0;
+    other._mask = 0;
+
+    return *this;
+  }
+
+  // Returns the value and whether it was inserted; an existing value is left untouched
+  std::pair<V*, bool> insert(const K& key, const V& value) {
+    if ((_size + 1) * 8 > capacity() * 7) {
+      rehash(_entries ? capacity() * 2 : capacityFor(_size + 1));
+    }
+
+    size_t index = indexFor(key);
+    while (_used[index]) {
+      if (_entries[index].key == key) {
+        return {&_entries[index].value, false};
+      }
+      index = (index + 1) & _mask;
+    }
+
+    _used[index] = 1;
+    _entries[index].key = key;
+    _entries[index].value = value;
+    ++_size;
+    return {&_entries[index].value, true};
+  }
+
+  void insert_or_assign(const K& key, const V& value) {
+    auto [slot, inserted] = insert(key, value);
+    if (!inserted) {
+      *slot = value;
+    }
+  }
+
+  // Value initializes missing entries
+  V& operator[](const K& key) { return *insert(key, V{}).first; }
+
+  V* find(const K& key) {
+    if (!_entries) return nullptr;
+    size_t index = indexFor(key);
+    while (_used[index]) {
+      if (_entries[index].key == key) {
+        return &_entries[index].value;
+      }
+      index = (index + 1) & _mask;
+    }
+    return nullptr;
+  }
+
+  const V* find(const K& key) const { return const_cast<ArenaHashMap*>(this)->find(key); }
+
+  bool contains(const K& key) const { return find(key) != nullptr; }
+
+  bool erase(const K& key) {
+    if (!_entries) return false;
+    size_t index = indexFor(key);
+    while (_used[index]) {
+      if (_entries[index].key == key) {
+        backwardShift(index);
+        --_size;
+        return true;
+      }
+      index = (index + 1) & _mask;
+    }
+    return false;
+  }
+
+  void clear() {
+    if (_used) {
+      std::memset(_used, 0, capacity());
+    }
+    _size = 0;
+  }
+
+  void reserve(size_t expectedSize) {
+    size_t wanted = capacityFor(expectedSize);
+    if (wanted > capacity()) {
+      rehash(wanted);
+    }
+  }
+
+  // fn(const K&, V&) for every entry, in table order
+  template <typename Fn>
+  void forEach(Fn&& fn) {
+    for (size_t i = 0; i < capacity(); ++i) {
+      if (_used[i]) {
+        fn(static_cast<const K&>(_entries[i].key), _entries[i].value);
+      }
+    }
+  }
+
+  size_t size() const { return _size; }
+  size_t capacity() const { return _entries ? _mask + 1 : 0; }
+  bool empty() const { return _size == 0; }
+
+ private:
+  static size_t capacityFor(size_t expectedSize) {
+    size_t capacity = 8;
+    while (capacity * 7 < expectedSize * 8) {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+  size_t indexFor(const K& key) const { return static_cast<size_t>(Hash{}(key)) & _mask; }
+
+  // Pulls later entries of the cluster into the hole as long as that
+  // doesn't move them in front of their home slot
+  void backwardShift(size_t hole) {
+    size_t index = (hole + 1) & _mask;
+    while (_used[index]) {
+      size_t home = indexFor(_entries[index].key);
+      if (((index - home) & _mask) >= ((index - hole) & _mask)) {
+        _entries[hole] = _entries[index];
+        hole = index;
+      }
+      index = (index + 1) & _mask;
+    }
+    _used[hole] = 0;
+  }
+
+  void rehash(size_t newCapacity) {
+    Entry* oldEntries = _entries;
+    uint8_t* oldUsed = _used;
+    size_t oldCapacity = capacity();
+
+    assert(_arena && "ArenaHashMap was default constructed, move an arena backed map into it first");
+    _entries = _arena->allocate<Entry>(newCapacity);
+    _used = _arena->allocate<uint8_t>(newCapacity);
+    assert(_entries && _used && "Arena out of memory");
+    std::memset(_used, 0, newCapacity);
+    _mask = newCapacity - 1;
+
+    for (size_t i = 0; i < oldCapacity; ++i) {
+      if (!oldUsed[i]) continue;
+      size_t index = indexFor(oldEntries[i].key);
+      while (_used[index]) {
+        index = (index + 1) & _mask;
+      }
+      _used[index] = 1;
+      _entries[index] = oldEntries[i];
+    }
+  }
+
+  FrameArena* _arena = nullptr;
+  Entry* _entries = nullptr;
+  uint8_t* _used = nullptr;
+  size_t _size = 0;
+  size_t _mask = 0;
+};
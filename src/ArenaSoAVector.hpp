@@ -0,0 +1,176 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "FrameArena.hpp"
+
+//
+//  Structure-of-arrays vector: one contiguous column per field, each
+//  starting on an `Alignment` byte boundary (64 = cache line / AVX-512,
+//  32 = AVX2), so kernels can stream a single field with aligned loads.
+//
+//      ArenaSoAVector<float, float, float, uint32_t> particles(&arena, 1024);
+//      particles.push_back(x, y, z, id);
+//      std::span<float> xs = particles.column<0>();
+//
+//  All columns live in one arena block. Growing allocates a new block and
+//  copies each column, the old block is lost until the arena is reset.
+//
+template <size_t Alignment, typename... Ts>
+class BasicArenaSoAVector {
+ public:
+  static_assert(sizeof...(Ts) > 0);
+  static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of 2");
+  static_assert((std::is_trivially_copyable_v<Ts> && ...), "Arena columns must be trivially copyable");
+  static_assert((std::is_trivially_destructible_v<Ts> && ...), "Arena columns must be trivially destructible");
+
+  static constexpr size_t ColumnCount = sizeof...(Ts);
+
+  template <size_t I>
+  using ColumnType = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+  BasicArenaSoAVector() = default;
+  ~BasicArenaSoAVector() = default;
+
+  // A zero capacity allocates nothing until the first push_back
+  explicit BasicArenaSoAVector(FrameArena* arena, size_t initialCapacity = 16) : _arena(arena) {
+    if (initialCapacity > 0) {
+      grow(initialCapacity);
+    }
+  }
+
+  BasicArenaSoAVector(const BasicArenaSoAVector&) noexcept = delete;
+  BasicArenaSoAVector& operator=(const BasicArenaSoAVector&) noexcept = delete;
+
+  BasicArenaSoAVector(BasicArenaSoAVector&& other) noexcept
+      : _arena(other._arena), _columns(other._columns), _size(other._size), _capacity(other._capacity) {
+    other._arena = nullptr;
+    other._columns = {};
+    other._size = 0;
+    other._capacity = 0;
+  }
+
+  BasicArenaSoAVector& operator=(BasicArenaSoAVector&& other) noexcept {
+    if (&other == this) {
+      return *this;
+    }
+
+    _arena = other._arena;
+    _columns = other._columns;
+    _size = other._size;
+    _capacity = other._capacity;
+
+    other._arena = nullptr;
+    other._columns = {};
+    other._size = 0;
+    other._capacity = 0;
+
+    return *this;
+  }
+
+  void push_back(const Ts&... values) {
+    if (_size >= _capacity) {
+      grow(_capacity > 0 ? _capacity * 2 : 16);
+    }
+    store(_size++, std::index_sequence_for<Ts...>{}, values...);
+  }
+
+  // New elements are left uninitialized
+  void resize(size_t size) {
+    reserve(size);
+    _size = size;
+  }
+
+  void reserve(size_t capacity) {
+    if (_capacity < capacity) {
+      grow(capacity);
+    }
+  }
+
+  void clear() { _size = 0; }
+
+  template <size_t I>
+  ColumnType<I>* data() {
+    return static_cast<ColumnType<I>*>(_columns[I]);
+  }
+
+  template <size_t I>
+  const ColumnType<I>* data() const {
+    return static_cast<const ColumnType<I>*>(_columns[I]);
+  }
+
+  template <size_t I>
+  std::span<ColumnType<I>> column() {
+    return {data<I>(), _size};
+  }
+
+  template <size_t I>
+  std::span<const ColumnType<I>> column() const {
+    return {data<I>(), _size};
+  }
+
+  template <size_t I>
+  ColumnType<I>& get(size_t i) {
+    assert(i < _size);
+    return data<I>()[i];
+  }
+
+  template <size_t I>
+  const ColumnType<I>& get(size_t i) const {
+    assert(i < _size);
+    return data<I>()[i];
+  }
+
+  size_t size() const { return _size; }
+  size_t capacity() const { return _capacity; }
+  bool empty() const { return _size == 0; }
+
+ private:
+  template <size_t... Is>
+  void store(size_t index, std::index_sequence<Is...>, const Ts&... values) {
+    ((data<Is>()[index] = values), ...);
+  }
+
+  static constexpr size_t alignUp(size_t value) { return (value + Alignment - 1) & ~(Alignment - 1); }
+
+  void grow(size_t newCapacity) {
+    constexpr std::array<size_t, ColumnCount> sizes{sizeof(Ts)...};
+
+    size_t total = 0;
+    for (size_t size : sizes) {
+      total += alignUp(size * newCapacity);
+    }
+
+    assert(_arena && "ArenaSoAVector was default constructed, move an arena backed vector into it first");
+    auto* block = static_cast<std::byte*>(_arena->allocateRaw(total, Alignment));
+    assert(block && "Arena out of memory");
+
+    std::array<void*, ColumnCount> columns{};
+    size_t offset = 0;
+    for (size_t i = 0; i < ColumnCount; ++i) {
+      columns[i] = block + offset;
+      if (_size > 0) {
+        std::memcpy(columns[i], _columns[i], sizes[i] * _size);
+      }
+      offset += alignUp(sizes[i] * newCapacity);
+    }
+
+    _columns = columns;
+    _capacity = newCapacity;
+  }
+
+  FrameArena* _arena = nullptr;
+  std::array<void*, ColumnCount> _columns{};
+  size_t _size = 0;
+  size_t _capacity = 0;
+};
+
+template <typename... Ts>
+using ArenaSoAVector = BasicArenaSoAVector<64, Ts...>;
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cassert>
 #include <cstddef>
 #include <cstring>
+#include <new>
 #include <span>
 #include <utility>
 
@@ -14,15 +16,18 @@ class ArenaVector {
   ~ArenaVector() = default;
 
   explicit ArenaVector(FrameArena* arena, size_t initialCapacity = 1)
-      : _arena(arena), _capacity(initialCapacity), _data(_arena->allocate<T>(initialCapacity)) {
+      : _arena(arena), _data(arena->allocate<T>(initialCapacity)), _capacity(initialCapacity) {
     assert(_data && "Arena out of memory");
   }
 
+  // Starts out in memory the caller carved from the arena, grows like any other ArenaVector
+  ArenaVector(FrameArena* arena, T* storage, size_t capacity) : _arena(arena), _data(storage), _capacity(capacity) {}
+
   ArenaVector(const ArenaVector&) noexcept = delete;
   ArenaVector& operator=(const ArenaVector&) noexcept = delete;
 
   ArenaVector(ArenaVector&& other) noexcept
-      : _arena(other.arena), _data(other.data), _size(other.size), _capacity(other.capacity) {
+      : _arena(other._arena), _data(other._data), _size(other._size), _capacity(other._capacity) {
     other._arena = nullptr;
     other._data = nullptr;
     other._size = 0;
@@ -64,7 +69,7 @@ class ArenaVector {
 
   void push_back(const T& value) {
     if (_size >= _capacity) {
-      grow(_capacity * 2);
+      grow(_capacity > 0 ? _capacity * 2 : 1);
     }
     _data[_size++] = value;
   }
@@ -72,7 +77,7 @@ class ArenaVector {
   template <typename... Args>
   T& emplace_back(Args&&... args) {
     if (_size >= _capacity) {
-      grow(_capacity * 2);
+      grow(_capacity > 0 ? _capacity * 2 : 1);
     }
     T* target = &_data[_size++];
     new (target) T(std::forward<Args>(args)...);
@@ -105,7 +110,14 @@ class ArenaVector {
   bool empty() const { return _size == 0; }
 
  private:
+  // Extends in place while the vector is the arena's latest allocation,
+  // otherwise moves to a new block and the old one is lost until reset()
   void grow(size_t newCapacity) {
+    if (_data && _arena->tryExtend(_data, sizeof(T) * _capacity, sizeof(T) * newCapacity)) {
+      _capacity = newCapacity;
+      return;
+    }
+
     T* newData = _arena->allocate<T>(newCapacity);
     assert(newData && "Arena out of memory");
     std::memcpy(newData, _data, sizeof(T) * _size);
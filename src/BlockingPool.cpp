@@ -0,0 +1,168 @@
+#include "BlockingPool.hpp"
+
+#include <string>
+
+#include "JobSystem.hpp"
+#include "ThreadAffinity.hpp"
+
+BlockingPool::BlockingPool(JobSystem* system, const BlockingPoolConfig& config, FrameArena* arena)
+    : _system(system), _config(config), _queue(config.queueCapacity, arena) {
+  assert(_config.maxThreads > 0 && "BlockingPool needs at least one thread");
+  assert(_config.minThreads <= _config.maxThreads);
+
+  std::lock_guard lock(_mutex);
+  for (size_t i = 0; i < _config.minThreads; ++i) {
+    spawnThread();
+  }
+}
+
+BlockingPool::~BlockingPool() {
+  shutdown();
+}
+
+void BlockingPool::shutdown() {
+  {
+    std::lock_guard lock(_mutex);
+    if (!_running) return;
+    _running = false;
+  }
+  _wakeup.notify_all();
+
+  // No new threads can be spawned once _running is false
+  for (auto& thread : _threads) {
+    if (thread->thread.joinable()) {
+      thread->thread.join();
+    }
+  }
+  _threads.clear();
+  _queue.shutdown();
+}
+
+void BlockingPool::submit(Job& job) {
+  // The pending count is taken before the job is enqueued so shutdown() can't
+  // join the threads between the two, pool threads wait for the job to show up
+  bool accepted = false;
+  {
+    std::lock_guard lock(_mutex);
+    accepted = _running;
+    if (accepted) {
+      ++_pending;
+
+      size_t freeThreads = _threadCount - _busy;
+      if (_pending > freeThreads && _threadCount < _config.maxThreads) {
+        spawnThread();
+      }
+    }
+  }
+
+  // Late jobs (e.g. spawned by compute jobs while the job system is being
+  // destroyed) finish cancelled so their waiters and graphs are released
+  if (!accepted) {
+    cancelLateJob(job);
+    return;
+  }
+
+  while (!_queue.try_enqueue(std::move(job))) {
+    std::this_thread::yield();
+  }
+  _wakeup.notify_one();
+}
+
+void BlockingPool::cancelLateJob(Job& job) {
+  if (job.control) {
+    job.control->cancelRequested.store(true, std::memory_order_relaxed);
+  }
+  job.fn = nullptr;
+  _system->execute(job);
+}
+
+// Requires _mutex
+void BlockingPool::spawnThread() {
+  reapFinishedThreads();
+
+  auto thread = std::make_unique<PoolThread>();
+  PoolThread* self = thread.get();
+  uint32_t id = _spawned++;
+  ++_threadCount;
+
+  self->thread = std::thread([this, self, id]() {
+    ThreadAffinity::setCurrentThreadName("blocking-" + std::to_string(id));
+    run(self);
+  });
+  _threads.emplace_back(std::move(thread));
+}
+
+// Requires _mutex
+void BlockingPool::reapFinishedThreads() {
+  for (size_t i = 0; i < _threads.size();) {
+    if (_threads[i]->finished.load(std::memory_order_acquire)) {
+      _threads[i]->thread.join();
+      _threads[i] = std::move(_threads.back());
+      _threads.pop_back();
+    } else {
+      ++i;
+    }
+  }
+}
+
+void BlockingPool::run(PoolThread* self) {
+  std::unique_lock lock(_mutex);
+
+  while (true) {
+    if (_pending > 0) {
+      --_pending;
+      ++_busy;
+      lock.unlock();
+
+      // A pending count guarantees an enqueued job, it may just not be visible yet
+      Job job;
+      while (!_queue.try_dequeue(job)) {
+        std::this_thread::yield();
+      }
+      execute(job);
+
+      lock.lock();
+      --_busy;
+      continue;
+    }
+
+    if (!_running) break;
+
+    bool woken = _wakeup.wait_for(lock, _config.idleTimeout, [this]() { return _pending > 0 || !_running; });
+    if (!woken && _threadCount > _config.minThreads) {
+      break;
+    }
+  }
+
+  --_threadCount;
+  self->finished.store(true, std::memory_order_release);
+}
+
+void BlockingPool::execute(Job& job) {
+  Job continuation;
+  continuation.fn = job.onComplete;
+  continuation.userData = job.userData;
+  continuation.arena = job.arena;
+  continuation.priority = job.priority;
+  if (HasFlag(job.flags, JobFlags::HighPriority)) {
+    continuation.flags = JobFlags::HighPriority;
+  }
+  continuation.deadline = job.deadline;
+
+  job.onComplete = nullptr;
+  _system->execute(job);
+
+  if (continuation.fn) {
+    _system->submit(continuation);
+  }
+}
+
+size_t BlockingPool::threadCount() const {
+  std::lock_guard lock(_mutex);
+  return _threadCount;
+}
+
+size_t BlockingPool::busyCount() const {
+  std::lock_guard lock(_mutex);
+  return _busy;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameArena.hpp"
+#include "Job.hpp"
+#include "LockFreeQueue.hpp"
+
+class JobSystem;
+
+//
+//  Threads are spawned on demand when a job arrives and no pool thread is
+//  free, up to `maxThreads`. Threads idle for longer than `idleTimeout`
+//  exit until only `minThreads` remain.
+//
+struct BlockingPoolConfig {
+  size_t minThreads = 0;
+  size_t maxThreads = 16;
+  std::chrono::milliseconds idleTimeout{2000};
+  size_t queueCapacity = 256;
+};
+
+//
+//  Elastic lane for JobFlags::LongRunning jobs (file I/O, blocking waits).
+//  These jobs never occupy one of the compute workers, so a graph mixing
+//  blocking and compute nodes keeps its full compute throughput.
+//
+//  Only the job's `fn` runs on the pool thread. `onComplete` (which for
+//  graph nodes releases dependents through JobGraph::onJobComplete) is
+//  submitted back to the compute workers so dependents are scheduled from
+//  there and never inherit the blocking thread. That continuation keeps the
+//  job's priority and deadline (and is accounted as a deadline job of its
+//  own), so it isn't queued behind Normal work.
+//
+//  Jobs submitted after shutdown() never run: they finish Cancelled (with
+//  their onComplete still called) on the submitting thread.
+//
+//  Sleeping and spawning are guarded by a mutex: jobs on this lane are
+//  expected to block for far longer than the lock is ever held.
+//
+class BlockingPool {
+ public:
+  BlockingPool(JobSystem* system, const BlockingPoolConfig& config, FrameArena* arena);
+  ~BlockingPool();
+
+  BlockingPool(const BlockingPool&) = delete;
+  BlockingPool& operator=(const BlockingPool&) = delete;
+
+  void submit(Job& job);
+  void shutdown();
+
+  size_t threadCount() const;
+  size_t busyCount() const;
+
+ private:
+  struct PoolThread {
+    std::thread thread;
+    std::atomic<bool> finished = false;
+  };
+
+  void spawnThread();
+  void reapFinishedThreads();
+  void run(PoolThread* self);
+  void execute(Job& job);
+  void cancelLateJob(Job& job);
+
+  JobSystem* _system = nullptr;
+  BlockingPoolConfig _config;
+  LockFreeQueue<Job> _queue;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _wakeup;
+  std::vector<std::unique_ptr<PoolThread>> _threads;
+  size_t _pending = 0;      // Jobs queued but not yet picked up
+  size_t _busy = 0;         // Threads currently running a job
+  size_t _threadCount = 0;  // Live threads, finished ones may still await a join
+  uint32_t _spawned = 0;    // Used for thread names only
+  bool _running = true;
+};
@@ -0,0 +1,63 @@
+#include "ContinuationPool.hpp"
+
+#include <cassert>
+
+static uint64_t packHead(uint64_t previous, uint32_t id) {
+  return (((previous >> 32) + 1) << 32) | id;
+}
+
+ContinuationPool::~ContinuationPool() {
+  for (uint32_t i = 0; i < _blockCount; ++i) {
+    delete[] _blocks[i].load(std::memory_order_relaxed);
+  }
+}
+
+uint32_t ContinuationPool::acquire() {
+  uint64_t head = _freeHead.load(std::memory_order_acquire);
+  while (true) {
+    auto id = static_cast<uint32_t>(head);
+    if (id == 0) {
+      grow();
+      head = _freeHead.load(std::memory_order_acquire);
+      continue;
+    }
+
+    // May read a node another thread just popped, the tag makes the CAS fail then
+    uint32_t next = get(id).nextFree.load(std::memory_order_relaxed);
+    if (_freeHead.compare_exchange_weak(head, packHead(head, next), std::memory_order_acquire, std::memory_order_acquire)) {
+      return id;
+    }
+  }
+}
+
+void ContinuationPool::release(uint32_t id) {
+  assert(id != 0);
+  Continuation& node = get(id);
+  uint64_t head = _freeHead.load(std::memory_order_relaxed);
+  do {
+    node.nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+  } while (!_freeHead.compare_exchange_weak(head, packHead(head, id), std::memory_order_release, std::memory_order_relaxed));
+}
+
+void ContinuationPool::grow() {
+  std::lock_guard lock(_growMutex);
+
+  // Another thread may have refilled the pool while we waited for the lock
+  if (static_cast<uint32_t>(_freeHead.load(std::memory_order_acquire)) != 0) return;
+
+  assert(_blockCount < MaxBlocks && "Too many pending continuations");
+  auto* block = new Continuation[BlockSize];
+  uint32_t firstId = _blockCount * BlockSize + 1;
+  for (uint32_t i = 0; i + 1 < BlockSize; ++i) {
+    block[i].nextFree.store(firstId + i + 1, std::memory_order_relaxed);
+  }
+  _blocks[_blockCount].store(block, std::memory_order_release);
+  ++_blockCount;
+
+  // Splice the whole block onto the free stack, its last node points at the old head
+  Continuation& last = block[BlockSize - 1];
+  uint64_t head = _freeHead.load(std::memory_order_relaxed);
+  do {
+    last.nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+  } while (!_freeHead.compare_exchange_weak(head, packHead(head, firstId), std::memory_order_release, std::memory_order_relaxed));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "Job.hpp"
+
+//
+//  A job waiting on a JobControlBlock. Continuations of one control block
+//  form an intrusive list through `next`, linked by id so the control block
+//  can keep the list head in a single 32-bit atomic.
+//
+struct Continuation {
+  Job job;
+  uint32_t next = 0;
+  bool runInline = false;  // Bookkeeping callbacks (whenAll/whenAny) run on the finishing thread
+  std::atomic<uint32_t> nextFree = 0;
+};
+
+//
+//  Continuation storage. Nodes are addressed by id (starting at 1, 0 means
+//  none) and recycled through a lock-free stack whose head carries a tag
+//  against ABA. The pool only takes its lock to add another block of nodes
+//  when it runs dry, so a steady state of attaching and dispatching never
+//  touches the heap.
+//
+class ContinuationPool {
+ public:
+  static constexpr uint32_t BlockSize = 1024;
+  static constexpr uint32_t MaxBlocks = 4096;
+
+  ContinuationPool() = default;
+  ~ContinuationPool();
+
+  ContinuationPool(const ContinuationPool&) = delete;
+  ContinuationPool& operator=(const ContinuationPool&) = delete;
+
+  uint32_t acquire();
+  void release(uint32_t id);
+
+  Continuation& get(uint32_t id) {
+    uint32_t index = id - 1;
+    return _blocks[index / BlockSize].load(std::memory_order_acquire)[index % BlockSize];
+  }
+
+ private:
+  void grow();
+
+  std::array<std::atomic<Continuation*>, MaxBlocks> _blocks{};
+  std::atomic<uint64_t> _freeHead = 0;  // Tag in the high half, id in the low half
+
+  std::mutex _growMutex;
+  uint32_t _blockCount = 0;
+};
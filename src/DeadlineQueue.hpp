@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "Job.hpp"
+
+//
+//  Earliest-deadline-first queue for jobs that carry a Job::deadline.
+//
+//  Ordering needs a heap, so unlike LockFreeQueue this takes a lock. The
+//  size is mirrored in an atomic so the scheduler can skip empty queues
+//  without touching the mutex, which keeps the common (no deadline) path
+//  lock free.
+//
+class DeadlineQueue {
+ public:
+  explicit DeadlineQueue(size_t reserve = 64) {
+    _heap.reserve(reserve);
+  }
+
+  DeadlineQueue(const DeadlineQueue&) = delete;
+  DeadlineQueue& operator=(const DeadlineQueue&) = delete;
+
+  void push(const Job& job) {
+    std::lock_guard lock(_mutex);
+    _heap.push_back(job);
+    std::push_heap(_heap.begin(), _heap.end(), &DeadlineQueue::later);
+    _size.store(_heap.size(), std::memory_order_release);
+  }
+
+  bool try_pop(Job& out) {
+    if (empty()) return false;
+
+    std::lock_guard lock(_mutex);
+    if (_heap.empty()) return false;
+    std::pop_heap(_heap.begin(), _heap.end(), &DeadlineQueue::later);
+    out = _heap.back();
+    _heap.pop_back();
+    _size.store(_heap.size(), std::memory_order_release);
+    return true;
+  }
+
+  // Earliest queued deadline, 0 when empty
+  uint64_t earliest() const {
+    if (empty()) return 0;
+
+    std::lock_guard lock(_mutex);
+    return _heap.empty() ? 0 : _heap.front().deadline;
+  }
+
+  bool empty() const { return _size.load(std::memory_order_acquire) == 0; }
+  size_t size_approx() const { return _size.load(std::memory_order_relaxed); }
+
+ private:
+  // std heaps are max-heaps, invert the comparison for a min-heap on deadline
+  static bool later(const Job& a, const Job& b) { return a.deadline > b.deadline; }
+
+  mutable std::mutex _mutex;
+  std::vector<Job> _heap;
+  std::atomic<size_t> _size = 0;
+};
@@ -1,36 +1,288 @@
 #include "FrameArena.hpp"
 
-FrameArena::FrameArena(size_t size)
-    : _start(new std::byte[size]), _ptr(_start), _size(size) {
-  assert((size & (size - 1)) == 0);  // size is a power of 2
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+
+#include "NumaTopology.hpp"
+
+namespace {
+
+// A thread's current sub-chunk of a Concurrent arena
+struct ArenaChunk {
+  uint64_t generation = 0;
+  std::byte* ptr = nullptr;
+  std::byte* end = nullptr;
+};
+
+// A handful of concurrent arenas (frame, long lived, ...) are live at once
+constexpr size_t CachedChunksPerThread = 4;
+
+static thread_local std::array<ArenaChunk, CachedChunksPerThread> t_chunks{};
+static thread_local uint32_t t_nextEvicted = 0;
+
+// Shared by every arena so a generation never matches a chunk of another
+// (or a destroyed) arena, 0 is never handed out
+static std::atomic<uint64_t> s_nextGeneration = 1;
+
+ArenaChunk* findChunk(uint64_t generation) {
+  for (auto& cached : t_chunks) {
+    if (cached.generation == generation) {
+      return &cached;
+    }
+  }
+  return nullptr;
 }
 
-FrameArena::FrameArena(void* buffer, size_t size)
+constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+std::byte* alignUp(std::byte* ptr, size_t alignment) {
+  auto address = reinterpret_cast<uintptr_t>(ptr);
+  return ptr + (((address + alignment - 1) & ~(alignment - 1)) - address);
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+FrameArena::FrameArena(size_t size, FrameArenaMode mode)
+    : _start(new std::byte[size]), _ptr(_start), _size(size), _backing(Backing::Heap) {
+  init(mode);
+}
+
+FrameArena::FrameArena(void* buffer, size_t size, FrameArenaMode mode)
     : _start(reinterpret_cast<std::byte*>(buffer)),
       _ptr(_start),
-      _size(size) {}
+      _size(size) {
+  init(mode);
+}
 
-FrameArena::FrameArena(std::span<std::byte> backing)
+FrameArena::FrameArena(std::span<std::byte> backing, FrameArenaMode mode)
     : _start(backing.data()),
       _ptr(_start),
-      _size(backing.size()) {}
+      _size(backing.size()) {
+  init(mode);
+}
+
+FrameArena::FrameArena(const VirtualArenaConfig& config, FrameArenaMode mode) : _backing(Backing::Virtual) {
+  assert(config.reserve > 0);
+
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t alignment = config.hugePages ? HugePageSize : page;
+  _commitGranularity = config.commitGranularity ? config.commitGranularity : (config.hugePages ? HugePageSize : 64 * 1024);
+  _commitGranularity = alignUp(_commitGranularity, page);
+  _retainCommitted = config.retainCommitted;
+  _size = alignUp(config.reserve, alignment);
+
+  // Over-reserve so the range can start on a huge page boundary, then trim
+  _mappingSize = _size + alignment - page;
+  void* mapping = mmap(nullptr, _mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  assert(mapping != MAP_FAILED && "FrameArena failed to reserve address space");
+
+  auto* base = static_cast<std::byte*>(mapping);
+  _start = alignUp(base, alignment);
+  if (_start > base) {
+    munmap(base, static_cast<size_t>(_start - base));
+  }
+  std::byte* tail = _start + _size;
+  std::byte* mappingEnd = base + _mappingSize;
+  if (mappingEnd > tail) {
+    munmap(tail, static_cast<size_t>(mappingEnd - tail));
+  }
+  _mappingSize = _size;
+
+  // Best effort, THP may be disabled or the kernel may not know about NUMA
+  if (config.hugePages) {
+    madvise(_start, _size, MADV_HUGEPAGE);
+  }
+  NumaMemory::bind(_start, _size, config.numaNode);
+
+  _ptr.store(_start, std::memory_order_relaxed);
+  _committedEnd.store(_start, std::memory_order_relaxed);
+  init(mode);
+}
+
+FrameArena::~FrameArena() {
+  if (_backing == Backing::Heap) {
+    delete[] _start;
+  } else if (_backing == Backing::Virtual) {
+    munmap(_start, _mappingSize);
+  }
+}
+
+void FrameArena::init(FrameArenaMode mode) {
+  _mode = mode;
+  // Small arenas still get enough chunks to go around a few threads
+  _chunkSize = std::max<size_t>(256, std::min(DefaultChunkSize, _size / 8) & ~size_t(63));
+  _generation.store(s_nextGeneration.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+}
 
 void* FrameArena::allocateRaw(size_t bytes, size_t alignment) {
   assert(bytes > 0);
   assert((alignment & (alignment - 1)) == 0);  // alignment is a power of 2
-  size_t offset = reinterpret_cast<size_t>(_ptr);
-  size_t alignmentPadding = ((offset + alignment - 1) & ~(alignment - 1)) - offset;
-  size_t alignedSize = alignmentPadding + bytes;
 
-  if (_ptr + alignedSize <= _start + _size) {
-    void* result = _ptr + alignmentPadding;
-    _ptr += alignedSize;
+  if (_mode == FrameArenaMode::Concurrent) {
+    return allocateConcurrent(bytes, alignment);
+  }
+
+  std::byte* ptr = _ptr.load(std::memory_order_relaxed);
+  std::byte* result = alignUp(ptr, alignment);
+
+  if (result + bytes <= _start + _size && commitUpTo(result + bytes)) {
+    _ptr.store(result + bytes, std::memory_order_relaxed);
     return result;
   }
   return nullptr;
 }
 
-void FrameArena::reset() { _ptr = _start; }
-size_t FrameArena::used() const { return static_cast<size_t>(_ptr - _start); }
+// Lock free bump of the shared pointer
+void* FrameArena::allocateShared(size_t bytes, size_t alignment) {
+  std::byte* ptr = _ptr.load(std::memory_order_relaxed);
+  while (true) {
+    std::byte* result = alignUp(ptr, alignment);
+    if (result + bytes > _start + _size) {
+      return nullptr;
+    }
+    if (_ptr.compare_exchange_weak(ptr, result + bytes, std::memory_order_relaxed)) {
+      // On failure the range stays claimed but unusable until reset()
+      return commitUpTo(result + bytes) ? result : nullptr;
+    }
+  }
+}
+
+void* FrameArena::allocateConcurrent(size_t bytes, size_t alignment) {
+  // Large allocations would waste most of a chunk, take them straight from the arena
+  if (bytes + alignment > _chunkSize / 4) {
+    return allocateShared(bytes, alignment);
+  }
+
+  uint64_t generation = _generation.load(std::memory_order_acquire);
+  ArenaChunk* chunk = findChunk(generation);
+
+  if (chunk) {
+    std::byte* result = alignUp(chunk->ptr, alignment);
+    if (result + bytes <= chunk->end) {
+      chunk->ptr = result + bytes;
+      return result;
+    }
+  } else {
+    chunk = &t_chunks[t_nextEvicted++ % CachedChunksPerThread];
+  }
+
+  // Cache line aligned so neighbouring chunks don't share lines between threads
+  auto* fresh = static_cast<std::byte*>(allocateShared(_chunkSize, 64));
+  if (!fresh) {
+    // The tail may still fit this allocation even though it can't fit a chunk
+    return allocateShared(bytes, alignment);
+  }
+
+  *chunk = {generation, fresh, fresh + _chunkSize};
+  std::byte* result = alignUp(chunk->ptr, alignment);
+  chunk->ptr = result + bytes;
+  return result;
+}
+
+bool FrameArena::tryExtend(void* block, size_t oldBytes, size_t newBytes) {
+  assert(newBytes >= oldBytes);
+  auto* begin = static_cast<std::byte*>(block);
+  std::byte* oldEnd = begin + oldBytes;
+  std::byte* newEnd = begin + newBytes;
+
+  if (_mode == FrameArenaMode::SingleThreaded) {
+    if (_ptr.load(std::memory_order_relaxed) != oldEnd || newEnd > _start + _size || !commitUpTo(newEnd)) {
+      return false;
+    }
+    _ptr.store(newEnd, std::memory_order_relaxed);
+    return true;
+  }
+
+  ArenaChunk* chunk = findChunk(_generation.load(std::memory_order_acquire));
+  if (chunk && chunk->ptr == oldEnd) {
+    if (newEnd > chunk->end) return false;
+    chunk->ptr = newEnd;
+    return true;
+  }
+
+  // Large allocations come straight from the shared pointer, commit
+  // first so a failed CAS only leaves extra committed memory behind
+  if (newEnd > _start + _size || !commitUpTo(newEnd)) return false;
+  return _ptr.compare_exchange_strong(oldEnd, newEnd, std::memory_order_relaxed);
+}
+
+// Lock free: mprotect on an already committed range is harmless, so racing
+// threads may both commit the same pages before one of them wins the CAS
+bool FrameArena::commitUpTo(std::byte* end) {
+  if (_backing != Backing::Virtual) return true;
+
+  std::byte* committed = _committedEnd.load(std::memory_order_acquire);
+  while (end > committed) {
+    std::byte* target = std::min(_start + alignUp(static_cast<size_t>(end - _start), _commitGranularity), _start + _size);
+    if (mprotect(committed, static_cast<size_t>(target - committed), PROT_READ | PROT_WRITE) != 0) {
+      return false;
+    }
+    if (_committedEnd.compare_exchange_weak(committed, target, std::memory_order_acq_rel)) {
+      return true;
+    }
+  }
+  return true;
+}
+
+void FrameArena::decommitAbove(size_t keep) {
+  std::byte* committed = _committedEnd.load(std::memory_order_relaxed);
+  std::byte* boundary = _start + std::min(alignUp(keep, _commitGranularity), _size);
+  if (boundary >= committed) return;
+
+  size_t length = static_cast<size_t>(committed - boundary);
+  madvise(boundary, length, MADV_DONTNEED);
+  mprotect(boundary, length, PROT_NONE);
+  _committedEnd.store(boundary, std::memory_order_release);
+}
+
+void FrameArena::prefault(size_t from) {
+  std::byte* end = _backing == Backing::Virtual ? _committedEnd.load(std::memory_order_acquire) : _start + _size;
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  for (std::byte* p = _start + alignUp(from, page); p < end; p += page) {
+    // Reading would map the shared zero page, only a write allocates
+    *reinterpret_cast<volatile std::byte*>(p) = *reinterpret_cast<volatile std::byte*>(p);
+  }
+}
+
+void FrameArena::trim() {
+  if (_backing == Backing::Virtual) {
+    decommitAbove(std::max(used(), _retainCommitted));
+  }
+}
+
+void FrameArena::reset() {
+  // What this frame used is the high-water mark the next one gets to keep
+  if (_backing == Backing::Virtual) {
+    decommitAbove(std::max(used(), _retainCommitted));
+  }
+
+  _ptr.store(_start, std::memory_order_relaxed);
+  if (_mode == FrameArenaMode::Concurrent) {
+    _generation.store(s_nextGeneration.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+  }
+}
+
+size_t FrameArena::mark() const { return used(); }
+
+void FrameArena::rewind(size_t mark) {
+  assert(_mode == FrameArenaMode::SingleThreaded && "Concurrent arenas can only be reset");
+  assert(mark <= used());
+  _ptr.store(_start + mark, std::memory_order_relaxed);
+}
+
+size_t FrameArena::used() const { return static_cast<size_t>(_ptr.load(std::memory_order_relaxed) - _start); }
 size_t FrameArena::capacity() const { return _size; }
 size_t FrameArena::remaining() const { return _size - used(); }
+FrameArenaMode FrameArena::mode() const { return _mode; }
+
+size_t FrameArena::committed() const {
+  if (_backing != Backing::Virtual) return _size;
+  return static_cast<size_t>(_committedEnd.load(std::memory_order_relaxed) - _start);
+}
@@ -1,15 +1,57 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <span>
+#include <type_traits>
 
+enum class FrameArenaMode : uint8_t {
+  SingleThreaded,  // Owned by one thread at a time, plain bump allocation
+  Concurrent       // Any thread may allocate, see below
+};
+
+//
+//  Backing for an arena that reserves address space up front and only
+//  commits (mprotect) it as the bump pointer advances, in
+//  `commitGranularity` steps. reset() keeps what the last frame used (at
+//  least `retainCommitted` bytes) and decommits the rest, so a one-off
+//  spike doesn't pin its memory forever. Unused reservation costs no RSS.
+//
+//  With `hugePages` the range is 2 MiB aligned and marked MADV_HUGEPAGE so
+//  transparent huge pages can back it (fewer TLB misses on large frame
+//  data); the default granularity then becomes 2 MiB.
+//
+//  `numaNode` applies the same MPOL_PREFERRED placement as NumaMemory.
+//
+struct VirtualArenaConfig {
+  size_t reserve = 0;
+  size_t commitGranularity = 0;  // 0 picks 2 MiB with huge pages, 64 KiB otherwise
+  size_t retainCommitted = 0;
+  bool hugePages = true;
+  int numaNode = -1;
+};
+
+//
+//  In Concurrent mode each thread bumps inside its own sub-chunk (cached
+//  thread locally) and only touches the shared pointer, with a CAS, to grab
+//  a new chunk or for allocations too large for one. reset() stays O(1): it
+//  rewinds the shared pointer and moves the arena to a new generation,
+//  which invalidates every thread's cached chunk.
+//
+//  reset() must not race with allocations in either mode, and used() in
+//  Concurrent mode includes the unused tails of handed out chunks.
+//
 class FrameArena {
  public:
-  explicit FrameArena(size_t size);
-  explicit FrameArena(void* buffer, size_t size);
-  explicit FrameArena(std::span<std::byte> backing);
-  ~FrameArena() = default;
+  static constexpr size_t DefaultChunkSize = 16 * 1024;
+
+  explicit FrameArena(size_t size, FrameArenaMode mode = FrameArenaMode::SingleThreaded);
+  explicit FrameArena(void* buffer, size_t size, FrameArenaMode mode = FrameArenaMode::SingleThreaded);
+  explicit FrameArena(std::span<std::byte> backing, FrameArenaMode mode = FrameArenaMode::SingleThreaded);
+  explicit FrameArena(const VirtualArenaConfig& config, FrameArenaMode mode = FrameArenaMode::SingleThreaded);
+  ~FrameArena();
 
   FrameArena(const FrameArena&) = delete;
   FrameArena& operator=(const FrameArena&) = delete;
@@ -21,14 +63,57 @@ class FrameArena {
 
   void* allocateRaw(size_t bytes, size_t aligment = alignof(std::max_align_t));
 
+  //
+  //  Grows `block` from `oldBytes` to `newBytes` without moving it. Only
+  //  works for the most recent allocation, i.e. when the block ends at the
+  //  bump pointer (in Concurrent mode: at the calling thread's chunk tip or
+  //  the shared pointer), and when there's room behind it.
+  //
+  bool tryExtend(void* block, size_t oldBytes, size_t newBytes);
+
+  // Scoped scratch on SingleThreaded arenas: rewind(mark()) frees everything allocated since
+  size_t mark() const;
+  void rewind(size_t mark);
+
   size_t used() const;
   size_t capacity() const;
   size_t remaining() const;
+  size_t committed() const;  // Bytes currently backed by memory, capacity() unless virtual
+  FrameArenaMode mode() const;
+
+  // Writes every committed page from offset `from` on so it's faulted in by (and, under first-touch,
+  // placed near) the calling thread. Memory already shared with other threads must lie below `from`.
+  void prefault(size_t from = 0);
+
+  // Decommits what reset() would without rewinding, for an arena that's done growing
+  void trim();
 
  private:
+  void init(FrameArenaMode mode);
+  void* allocateShared(size_t bytes, size_t alignment);
+  void* allocateConcurrent(size_t bytes, size_t alignment);
+  bool commitUpTo(std::byte* end);
+  void decommitAbove(size_t keep);
+
+  enum class Backing : uint8_t {
+    External,  // Caller owned buffer
+    Heap,
+    Virtual
+  };
+
   std::byte* _start = nullptr;
-  std::byte* _ptr = nullptr;
+  std::atomic<std::byte*> _ptr = nullptr;
   size_t _size = 0;
+
+  Backing _backing = Backing::External;
+  std::atomic<std::byte*> _committedEnd = nullptr;  // Virtual only, everything below is read/write
+  size_t _commitGranularity = 0;
+  size_t _retainCommitted = 0;
+  size_t _mappingSize = 0;
+
+  FrameArenaMode _mode = FrameArenaMode::SingleThreaded;
+  size_t _chunkSize = 0;
+  std::atomic<uint64_t> _generation = 0;  // Globally unique, changes on every reset()
 };
 
 template <typename T>
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//
+//  Small non-cryptographic 64-bit hashing helpers.
+//
+//  References:
+//
+//      https://xorshift.di.unimi.it/splitmix64.c
+//      https://github.com/aappleby/smhasher
+//
+
+inline uint64_t hashMix(uint64_t x) {
+  // splitmix64 finalizer
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+  return hashMix(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+}
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0) {
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = hashMix(seed ^ (size * 0x9e3779b97f4a7c15ull));
+
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes, 8);
+    hash = (hash ^ hashMix(word)) * 0xff51afd7ed558ccdull;
+    bytes += 8;
+    size -= 8;
+  }
+
+  if (size > 0) {
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes, size);
+    hash = (hash ^ hashMix(tail)) * 0xff51afd7ed558ccdull;
+  }
+
+  return hashMix(hash);
+}
@@ -0,0 +1,325 @@
+#include "IoService.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include "JobSystem.hpp"
+#include "ThreadAffinity.hpp"
+
+//
+//  References:
+//
+//      https://kernel.dk/io_uring.pdf
+//      https://man7.org/linux/man-pages/man7/io_uring.7.html
+//
+//  Raw syscalls instead of liburing to keep the build dependency free.
+//
+
+static int ioUringSetup(uint32_t entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int fd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int ioUringRegister(int fd, uint32_t opcode, void* arg, uint32_t count) {
+  return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// user_data of the NOP used to wake the poller on shutdown
+static constexpr uint64_t WakeupToken = 0;
+
+IoService::IoService(JobSystem* system, const IoServiceConfig& config) : _system(system) {
+  if (config.backend != IoBackend::ThreadPool && initRing(config.queueDepth)) {
+    _backend = IoBackend::IoUring;
+    _poller = std::thread([this]() {
+      ThreadAffinity::setCurrentThreadName("io-poller");
+      pollCompletions();
+    });
+  } else {
+    assert(config.backend != IoBackend::IoUring && "io_uring requested but not supported by this kernel");
+    _backend = IoBackend::ThreadPool;
+  }
+}
+
+IoService::~IoService() {
+  shutdown();
+}
+
+bool IoService::initRing(uint32_t depth) {
+  io_uring_params params{};
+  _ringFd = ioUringSetup(depth, &params);
+  if (_ringFd < 0) {
+    _ringFd = -1;
+    return false;
+  }
+
+  // IORING_OP_READ/WRITE need 5.6+, older kernels use the thread pool
+  size_t probeSize = sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op);
+  auto probeStorage = std::make_unique<std::byte[]>(probeSize);
+  std::memset(probeStorage.get(), 0, probeSize);
+  auto* probe = reinterpret_cast<io_uring_probe*>(probeStorage.get());
+  if (ioUringRegister(_ringFd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0 ||
+      probe->last_op < IORING_OP_WRITE ||
+      !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) ||
+      !(probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED)) {
+    destroyRing();
+    return false;
+  }
+
+  _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (singleMmap) {
+    _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+  }
+
+  _sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+  if (_sqRing == MAP_FAILED) {
+    _sqRing = nullptr;
+    destroyRing();
+    return false;
+  }
+
+  if (singleMmap) {
+    _cqRing = _sqRing;
+  } else {
+    _cqRing = mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+    if (_cqRing == MAP_FAILED) {
+      _cqRing = nullptr;
+      destroyRing();
+      return false;
+    }
+  }
+
+  _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  _sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES);
+  if (_sqes == MAP_FAILED) {
+    _sqes = nullptr;
+    destroyRing();
+    return false;
+  }
+
+  auto* sq = static_cast<std::byte*>(_sqRing);
+  _sqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+  _sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+  _sqMask = reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+  _sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+  _sqEntries = params.sq_entries;
+
+  auto* cq = static_cast<std::byte*>(_cqRing);
+  _cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+  _cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+  _cqMask = reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+  _cqes = cq + params.cq_off.cqes;
+  _cqEntries = params.cq_entries;
+
+  return true;
+}
+
+void IoService::destroyRing() {
+  if (_sqes) munmap(_sqes, _sqesSize);
+  if (_cqRing && _cqRing != _sqRing) munmap(_cqRing, _cqRingSize);
+  if (_sqRing) munmap(_sqRing, _sqRingSize);
+  if (_ringFd >= 0) close(_ringFd);
+
+  _sqes = nullptr;
+  _cqRing = nullptr;
+  _sqRing = nullptr;
+  _ringFd = -1;
+}
+
+void IoService::shutdown() {
+  if (!_running.exchange(false)) return;
+  if (_backend != IoBackend::IoUring) return;
+
+  // Submitters check _running under the lock, once we got it every request
+  // that made it into the ring is counted in _inFlight
+  { std::lock_guard lock(_submitMutex); }
+
+  // Requests point at caller memory, let them land before tearing down the ring
+  while (_inFlight.load(std::memory_order_acquire) > 0) {
+    std::this_thread::yield();
+  }
+
+  submitToRing(nullptr);
+
+  if (_poller.joinable()) {
+    _poller.join();
+  }
+
+  std::lock_guard lock(_submitMutex);
+  destroyRing();
+}
+
+IoBackend IoService::backend() const { return _backend; }
+
+void IoService::submit(IoRequest& request) {
+  if (request.control) {
+    request.control->state.store(JobState::Pending, std::memory_order_relaxed);
+    request.control->reopenContinuations();
+  }
+
+  // Late requests (e.g. graph nodes dispatched while the job system is
+  // being destroyed) fail instead of touching a ring that's going away
+  bool submitted = false;
+  if (_running.load(std::memory_order_acquire)) {
+    if (_backend == IoBackend::IoUring) {
+      submitted = submitToRing(&request);
+    } else {
+      submitToPool(request);
+      submitted = true;
+    }
+  }
+
+  if (!submitted) {
+    if (request.control) {
+      request.control->cancelRequested.store(true, std::memory_order_relaxed);
+    }
+    complete(request, -ECANCELED);
+  }
+}
+
+// A null request submits the NOP that wakes the poller on shutdown. Returns
+// false when the service shut down before the request could be queued.
+bool IoService::submitToRing(IoRequest* request) {
+  while (true) {
+    // Never have more requests in flight than the completion ring can hold
+    if (request && _inFlight.load(std::memory_order_acquire) >= _cqEntries) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock lock(_submitMutex);
+    if (request && !_running.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    uint32_t tail = *_sqTail;
+    uint32_t head = std::atomic_ref<uint32_t>(*_sqHead).load(std::memory_order_acquire);
+    if (tail - head >= _sqEntries) {
+      lock.unlock();
+      std::this_thread::yield();
+      continue;
+    }
+
+    uint32_t index = tail & *_sqMask;
+    auto* sqe = &static_cast<io_uring_sqe*>(_sqes)[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    if (!request) {
+      sqe->opcode = IORING_OP_NOP;
+      sqe->user_data = WakeupToken;
+    } else {
+      sqe->opcode = request->op == IoOp::Read ? IORING_OP_READ : IORING_OP_WRITE;
+      sqe->fd = request->fd;
+      sqe->addr = reinterpret_cast<uint64_t>(request->buffer);
+      sqe->len = static_cast<uint32_t>(std::min<size_t>(request->size, UINT32_MAX));
+      sqe->off = request->offset;
+      sqe->user_data = reinterpret_cast<uint64_t>(request);
+      _inFlight.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    _sqArray[index] = index;
+    std::atomic_ref<uint32_t>(*_sqTail).store(tail + 1, std::memory_order_release);
+
+    int submitted = ioUringEnter(_ringFd, 1, 0, 0);
+    while (submitted < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) {
+      std::this_thread::yield();
+      submitted = ioUringEnter(_ringFd, 1, 0, 0);
+    }
+    assert(submitted >= 0 && "io_uring_enter failed to submit");
+    return true;
+  }
+}
+
+void IoService::pollCompletions() {
+  while (true) {
+    int result = ioUringEnter(_ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+    if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      return;
+    }
+
+    bool stop = false;
+    uint32_t head = *_cqHead;
+    uint32_t tail = std::atomic_ref<uint32_t>(*_cqTail).load(std::memory_order_acquire);
+
+    while (head != tail) {
+      const auto& cqe = static_cast<io_uring_cqe*>(_cqes)[head & *_cqMask];
+      uint64_t userData = cqe.user_data;
+      int32_t res = cqe.res;
+
+      ++head;
+      std::atomic_ref<uint32_t>(*_cqHead).store(head, std::memory_order_release);
+
+      if (userData == WakeupToken) {
+        stop = !_running.load(std::memory_order_acquire);
+        continue;
+      }
+
+      complete(*reinterpret_cast<IoRequest*>(userData), res);
+      _inFlight.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    if (stop) return;
+  }
+}
+
+void IoService::complete(IoRequest& request, int64_t result) {
+  request.result = result;
+
+  if (request.control) {
+    bool wasCancelled = request.control->cancelRequested.load(std::memory_order_relaxed);
+    _system->finish(*request.control, wasCancelled ? JobState::Cancelled : JobState::Completed);
+  }
+
+  if (request.onComplete) {
+    Job job;
+    job.fn = request.onComplete;
+    job.userData = request.userData;
+    _system->submit(job);
+  }
+}
+
+void IoService::submitToPool(IoRequest& request) {
+  Job job;
+  job.fn = &IoService::runBlocking;
+  job.onComplete = &IoService::onBlockingComplete;
+  job.userData = &request;
+  job.control = request.control;
+  job.flags = JobFlags::LongRunning;
+  _system->submit(job);
+}
+
+void IoService::runBlocking(void* userData) {
+  auto* request = static_cast<IoRequest*>(userData);
+
+  ssize_t result = 0;
+  do {
+    if (request->op == IoOp::Read) {
+      result = pread(request->fd, request->buffer, request->size, static_cast<off_t>(request->offset));
+    } else {
+      result = pwrite(request->fd, request->buffer, request->size, static_cast<off_t>(request->offset));
+    }
+  } while (result < 0 && errno == EINTR);
+
+  request->result = result < 0 ? -errno : result;
+}
+
+// Runs on a compute worker, the blocking pool already updated the control block
+void IoService::onBlockingComplete(void* userData) {
+  auto* request = static_cast<IoRequest*>(userData);
+  if (request->onComplete) {
+    request->onComplete(request->userData);
+  }
+}
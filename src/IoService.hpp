@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <thread>
+
+#include "Job.hpp"
+
+class JobSystem;
+
+enum class IoBackend {
+  Auto,       // io_uring when the kernel supports it, thread pool otherwise
+  IoUring,
+  ThreadPool  // Blocking pread/pwrite on the LongRunning pool
+};
+
+enum class IoOp : uint8_t {
+  Read,
+  Write
+};
+
+struct IoServiceConfig {
+  IoBackend backend = IoBackend::Auto;
+  uint32_t queueDepth = 256;
+};
+
+//
+//  A single asynchronous read or write. The request is owned by the caller
+//  and must stay alive until it completes.
+//
+//  `result` holds the number of bytes transferred, or -errno on failure.
+//  Like pread/pwrite a single request may transfer less than `size`.
+//  Requests submitted after shutdown() fail with -ECANCELED and finish
+//  Cancelled.
+//  Once the I/O finished `control` (if any) is marked Completed and
+//  `onComplete(userData)` runs as a job on the compute workers.
+//
+struct IoRequest {
+  int fd = -1;
+  void* buffer = nullptr;
+  size_t size = 0;
+  uint64_t offset = 0;
+  int64_t result = 0;
+
+  Job::JobFn onComplete = nullptr;
+  void* userData = nullptr;
+  JobControlBlock* control = nullptr;
+
+  IoOp op = IoOp::Read;
+};
+
+//
+//  Output of JobGraph::addReadFile. `data` points into the graph's arena.
+//
+struct ReadFileResult {
+  std::span<std::byte> data;
+  int64_t result = 0;  // Bytes read or -errno
+};
+
+//
+//  Issues IoRequests through io_uring. A poller thread sleeps in
+//  io_uring_enter() waiting on completions and hands every finished
+//  request back to the job system, so no worker ever blocks on I/O.
+//
+//  When io_uring isn't available (old kernel, seccomp) or the thread pool
+//  backend is requested, requests run as blocking LongRunning jobs instead.
+//  Both backends complete requests the same way.
+//
+class IoService {
+ public:
+  IoService(JobSystem* system, const IoServiceConfig& config);
+  ~IoService();
+
+  IoService(const IoService&) = delete;
+  IoService& operator=(const IoService&) = delete;
+
+  void submit(IoRequest& request);
+  void shutdown();
+
+  IoBackend backend() const;
+
+ private:
+  bool initRing(uint32_t depth);
+  void destroyRing();
+  bool submitToRing(IoRequest* request);
+  void submitToPool(IoRequest& request);
+  void pollCompletions();
+  void complete(IoRequest& request, int64_t result);
+
+  static void runBlocking(void* userData);
+  static void onBlockingComplete(void* userData);
+
+  JobSystem* _system = nullptr;
+  IoBackend _backend = IoBackend::ThreadPool;
+
+  // io_uring state, see io_uring_setup(2)
+  int _ringFd = -1;
+  void* _sqRing = nullptr;
+  void* _cqRing = nullptr;
+  size_t _sqRingSize = 0;
+  size_t _cqRingSize = 0;
+  void* _sqes = nullptr;
+  size_t _sqesSize = 0;
+
+  uint32_t* _sqHead = nullptr;
+  uint32_t* _sqTail = nullptr;
+  uint32_t* _sqMask = nullptr;
+  uint32_t* _sqArray = nullptr;
+  uint32_t _sqEntries = 0;
+
+  uint32_t* _cqHead = nullptr;
+  uint32_t* _cqTail = nullptr;
+  uint32_t* _cqMask = nullptr;
+  void* _cqes = nullptr;
+  uint32_t _cqEntries = 0;
+
+  std::mutex _submitMutex;
+  std::atomic<uint32_t> _inFlight = 0;
+  std::atomic<bool> _running = true;
+  std::thread _poller;
+};
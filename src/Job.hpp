@@ -5,18 +5,36 @@
 
 #include "FrameArena.hpp"
 
+class JobSystem;
+struct Job;
+
 enum JobFlags : uint32_t {
   None = 0,
-  HighPriority = 1 << 0,
-  LongRunning = 1 << 1,     // @TODO: Long running jobs (helps avoid stealing threads for jobs that block (I/O, streaming))
-  Cancelable = 1 << 2,      // @TODO: Cancelable jobs (enables early-out for expensive or unneeded jobs)
+  HighPriority = 1 << 0,    // Shorthand for JobPriority::High when the job's priority is left at Normal
+  LongRunning = 1 << 1,     // Runs on the elastic blocking pool instead of a compute worker (I/O, blocking waits)
+  Cancelable = 1 << 2,      // JobSystem::cancel may skip the job, or flag it so a running job can early-out
   FrameLocal = 1 << 3,      // @TODO: Signals the job's memory is frame-bound (tells system that it may safely reset arena after the frame ends)
-  WorkerAffinity = 1 << 4,  // @TODO: Job must run on a specific thread (tagged workers)
+  WorkerAffinity = 1 << 4,  // Job must run on a specific worker or worker group (see Job::workerGroup/Job::worker)
   Detached = 1 << 5,        // @TODO: Fire and forget job (allows system to pool or reuse resources aggressively)
   DebugTrace = 1 << 6,      // @TODO: Enable logging/profiling for this job only (tracing and debugging)
   SkipArenaReset = 1 << 7   // @TODO: Job system won’t reset thread-local arena after this job (job allocates long-lived memory)
 };
 
+//
+//  Scheduling classes, served highest first. Within a class jobs with a
+//  deadline run earliest-deadline-first ahead of the FIFO jobs, and classes
+//  that haven't been served for JobSystemConfig::agingThreshold jump the
+//  line so a flood of higher priority work can't starve them.
+//
+enum JobPriority : uint8_t {
+  Critical = 0,
+  High,
+  Normal,
+  Low,
+  Background,
+  PriorityCount
+};
+
 enum JobState {
   Pending,
   Running,
@@ -25,31 +43,65 @@ enum JobState {
 };
 
 struct JobControlBlock {
+  // Sealed once the job finished, continuations attached after that are dispatched right away
+  static constexpr uint32_t ContinuationsSealed = UINT32_MAX;
+
   std::atomic<JobState> state = JobState::Pending;
   std::atomic<bool> cancelRequested = false;
+  std::atomic<JobFlags> flags = JobFlags::None;  // Copied from the job on submit
+  std::atomic<uint32_t> continuations = 0;       // Head of the ContinuationPool list, 0 when empty
+
+  // Reopens the continuation list for another run, keeps continuations attached before it started
+  void reopenContinuations() {
+    uint32_t sealed = ContinuationsSealed;
+    continuations.compare_exchange_strong(sealed, 0, std::memory_order_relaxed);
+  }
 };
 
 struct JobHandle {
   uint32_t id = 0;
   uint32_t generation = 0;
   JobControlBlock* control = nullptr;
+  JobSystem* system = nullptr;  // Set by the system that handed the handle out, needed for then()
 
   bool isValid() const {
     return control != nullptr;
   }
+
+  // Shorthand for system->then(*this, next)
+  JobHandle then(Job& next) const;
 };
 
 struct Job {
   using JobFn = void (*)(void*);
 
+  static constexpr uint32_t AnyWorker = UINT32_MAX;
+
   JobFn fn = nullptr;
   JobFn onComplete = nullptr;
   void* userData = nullptr;
   FrameArena* arena = nullptr;
   JobControlBlock* control = nullptr;
   JobFlags flags = JobFlags::None;
+
+  // Only read when JobFlags::WorkerAffinity is set. `worker` is an index inside
+  // the group, AnyWorker lets the system pick one of the group's workers.
+  uint32_t workerGroup = 0;
+  uint32_t worker = AnyWorker;
+
+  JobPriority priority = JobPriority::Normal;
+  uint64_t deadline = 0;  // JobSystem::clockNow() based, in nanoseconds. 0 means no deadline
 };
 
+inline JobFlags operator|(JobFlags a, JobFlags b) {
+  return static_cast<JobFlags>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+}
+
+inline JobFlags& operator|=(JobFlags& a, JobFlags b) {
+  a = a | b;
+  return a;
+}
+
 inline bool HasFlag(JobFlags flags, JobFlags flag) {
   return (flags & flag) == flag;
 }
\ No newline at end of file
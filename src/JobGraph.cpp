@@ -1,13 +1,415 @@
 #include "JobGraph.hpp"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "JobGraphTemplate.hpp"
 #include "JobSystem.hpp"
 
+struct SubgraphNodeData {
+  JobGraph* graph;
+  JobGraph* child;
+  GraphNodeHandle handle;
+};
+
+struct FileIoNodeData {
+  IoRequest request;
+  JobGraph* graph;
+  GraphNodeHandle handle;
+  const char* path;  // Copied into the graph's arena, the file is opened on every run
+  int buildError;    // errno of a failure while building (no buffer), reported on every run
+  ReadFileResult* readResult;
+  size_t readSize;  // 0 reads to the end of the file, up to the buffer's capacity
+  void* readBuffer;
+  size_t readCapacity;
+  const std::span<const std::byte>* writeData;
+  int64_t* writeResult;
+};
+
+static const char* copyPath(FrameArena* arena, const char* path) {
+  size_t length = std::strlen(path) + 1;
+  auto* copy = static_cast<char*>(arena->allocateRaw(length, 1));
+  assert(copy && "Arena out of memory");
+  std::memcpy(copy, path, length);
+  return copy;
+}
+
+struct FusedChain {
+  JobGraph* graph;
+  uint32_t head;
+};
+
 JobGraph::JobGraph(FrameArena* arena, JobSystem* system) : _arena(arena), _system(system), _slots(arena, 256) {}
 
+GraphNodeHandle JobGraph::createSlot() {
+  _slots.emplace_back(_arena);
+  auto& slot = _slots.back();
+
+  auto* control = _arena->allocate<JobControlBlock>();
+  control->state.store(JobState::Pending);
+  control->cancelRequested.store(false);
+  control->flags.store(JobFlags::Cancelable);
+  control->continuations.store(0);
+  slot.job.control = control;
+  slot.control = control;
+
+  JobHandle jobHandle{.id = static_cast<uint32_t>(_slots.size()), .generation = 1, .control = control, .system = _system};
+
+  return GraphNodeHandle{
+      .index = static_cast<uint32_t>(_slots.size() - 1),
+      .generation = 1,
+      .jobHandle = jobHandle,
+  };
+}
+
+GraphNodeHandle JobGraph::addReadFile(const char* path, ReadFileResult* out, size_t size, uint64_t offset) {
+  GraphNodeHandle handle = createSlot();
+  auto& slot = _slots[handle.index];
+
+  auto* data = _arena->allocate<FileIoNodeData>();
+  *data = {};
+  data->graph = this;
+  data->handle = handle;
+  data->readResult = out;
+  data->request.op = IoOp::Read;
+  data->request.offset = offset;
+  data->request.onComplete = &JobGraph::finishFileIo;
+  data->request.userData = data;
+
+  data->path = copyPath(_arena, path);
+  data->readSize = size;
+
+  // Only the buffer is set up front, sized to the file as it is now. A
+  // whole-file read of a file that doesn't exist yet has nothing to size it by.
+  *out = {};
+  if (size == 0) {
+    struct stat info{};
+    if (stat(path, &info) != 0) {
+      data->buildError = errno;
+    } else if (static_cast<uint64_t>(info.st_size) > offset) {
+      size = static_cast<size_t>(info.st_size - offset);
+    }
+  }
+  if (size > 0) {
+    data->readBuffer = _arena->allocateRaw(size, 64);
+    data->readCapacity = data->readBuffer ? size : 0;
+    data->buildError = data->readBuffer ? 0 : ENOMEM;
+  }
+
+  // The node completes from the I/O completion, not when the job returns
+  slot.job.fn = &JobGraph::startFileIo;
+  slot.job.userData = data;
+  slot.job.arena = _arena;
+  slot.job.control = nullptr;
+  slot.job.flags = JobFlags::Cancelable;
+
+  return handle;
+}
+
+GraphNodeHandle JobGraph::addWriteFile(const char* path, const std::span<const std::byte>* data, int64_t* bytesWritten, uint64_t offset) {
+  GraphNodeHandle handle = createSlot();
+  auto& slot = _slots[handle.index];
+
+  auto* nodeData = _arena->allocate<FileIoNodeData>();
+  *nodeData = {};
+  nodeData->graph = this;
+  nodeData->handle = handle;
+  nodeData->writeData = data;
+  nodeData->writeResult = bytesWritten;
+  nodeData->request.op = IoOp::Write;
+  nodeData->request.offset = offset;
+  nodeData->request.onComplete = &JobGraph::finishFileIo;
+  nodeData->request.userData = nodeData;
+
+  nodeData->path = copyPath(_arena, path);
+
+  *bytesWritten = 0;
+
+  slot.job.fn = &JobGraph::startFileIo;
+  slot.job.userData = nodeData;
+  slot.job.arena = _arena;
+  slot.job.control = nullptr;
+  slot.job.flags = JobFlags::Cancelable;
+
+  return handle;
+}
+
+void JobGraph::startFileIo(void* userData) {
+  auto* data = static_cast<FileIoNodeData*>(userData);
+  IoRequest& request = data->request;
+
+  request.result = 0;
+  if (data->handle.jobHandle.control->cancelRequested.load(std::memory_order_acquire)) {
+    request.result = -ECANCELED;
+    finishFileIo(data);
+    return;
+  }
+  if (data->buildError != 0) {
+    request.result = -data->buildError;
+    finishFileIo(data);
+    return;
+  }
+
+  // Opened per run so re-submitted graphs (see rearm) read and write the file again
+  if (data->readResult) {
+    request.fd = open(data->path, O_RDONLY | O_CLOEXEC);
+  } else {
+    request.fd = open(data->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  }
+  if (request.fd < 0) {
+    request.result = -errno;
+    finishFileIo(data);
+    return;
+  }
+
+  if (data->readResult) {
+    size_t size = data->readSize;
+    struct stat info{};
+    if (size == 0 && fstat(request.fd, &info) == 0 && static_cast<uint64_t>(info.st_size) > request.offset) {
+      size = static_cast<size_t>(info.st_size - request.offset);
+    }
+    // The file grew past the buffer sized at build time, fail rather than truncate
+    if (size > data->readCapacity) {
+      request.result = -ENOBUFS;
+      finishFileIo(data);
+      return;
+    }
+    request.buffer = data->readBuffer;
+    request.size = size;
+  } else {
+    request.buffer = const_cast<std::byte*>(data->writeData->data());
+    request.size = data->writeData->size();
+  }
+
+  if (request.size == 0) {
+    finishFileIo(data);
+    return;
+  }
+
+  JobSystem& system = *data->graph->_system;
+  if (request.op == IoOp::Read) {
+    system.submitRead(request);
+  } else {
+    system.submitWrite(request);
+  }
+}
+
+void JobGraph::finishFileIo(void* userData) {
+  auto* data = static_cast<FileIoNodeData*>(userData);
+  IoRequest& request = data->request;
+
+  if (request.fd >= 0) {
+    close(request.fd);
+    request.fd = -1;
+  }
+
+  if (data->readResult) {
+    data->readResult->result = request.result;
+    data->readResult->data = {};
+    if (request.result > 0) {
+      data->readResult->data = {static_cast<std::byte*>(request.buffer), static_cast<size_t>(request.result)};
+    }
+  } else {
+    *data->writeResult = request.result;
+  }
+
+  // What was read is the node's output, writes always count as changed
+  JobGraph& graph = *data->graph;
+  if (graph._memoize) {
+    auto& slot = graph._slots[data->handle.index];
+    if (data->readResult) {
+      const auto& bytes = data->readResult->data;
+      slot.outputFingerprint = hashBytes(bytes.data(), bytes.size(), static_cast<uint64_t>(data->readResult->result));
+    } else {
+      slot.outputFingerprint = hashMix(graph._changeCounter.fetch_add(1, std::memory_order_relaxed) + 1);
+    }
+  }
+
+  graph.completeNode(data->handle);
+}
+
+void JobGraph::completeNode(GraphNodeHandle node) {
+  JobControlBlock* control = node.jobHandle.control;
+  if (control) {
+    bool wasCancelled = control->cancelRequested.load(std::memory_order_relaxed);
+    _system->finish(*control, wasCancelled ? JobState::Cancelled : JobState::Completed);
+  }
+  onJobComplete(node, *_system);
+}
+
+SubgraphInstances JobGraph::instantiate(const JobGraphTemplate& tmpl, size_t count, const SubgraphBindings& bindings,
+                                         std::initializer_list<GraphNodeHandle> after) {
+  assert(bindings.nodeCount() == tmpl.nodeCount() && "Bindings were made for a different template");
+
+  const auto nodeCount = static_cast<uint32_t>(tmpl.nodeCount());
+  const size_t total = count * nodeCount;
+  SubgraphInstances instances{
+      .firstIndex = static_cast<uint32_t>(_slots.size()),
+      .nodesPerInstance = nodeCount,
+      .count = static_cast<uint32_t>(count),
+  };
+  if (total == 0) return instances;
+
+  // Control blocks, node data and dependency lists of every instance in one block
+  const size_t controlBytes = sizeof(JobControlBlock) * total;
+  const size_t dataOffset = (controlBytes + alignof(BoundNodeData) - 1) & ~(alignof(BoundNodeData) - 1);
+  const size_t dataBytes = sizeof(BoundNodeData) * total;
+  const size_t dependentsOffset = (dataOffset + dataBytes + alignof(GraphNodeHandle) - 1) & ~(alignof(GraphNodeHandle) - 1);
+  const size_t dependentsBytes = sizeof(GraphNodeHandle) * tmpl.edgeCount() * count;
+
+  auto* block = static_cast<std::byte*>(_arena->allocateRaw(dependentsOffset + dependentsBytes, alignof(std::max_align_t)));
+  assert(block && "Arena out of memory");
+  auto* controls = reinterpret_cast<JobControlBlock*>(block);
+  auto* data = reinterpret_cast<BoundNodeData*>(block + dataOffset);
+  auto* dependents = reinterpret_cast<GraphNodeHandle*>(block + dependentsOffset);
+
+  _slots.reserve(_slots.size() + total);
+
+  size_t n = 0;
+  for (size_t i = 0; i < count; ++i) {
+    for (uint32_t k = 0; k < nodeCount; ++k, ++n) {
+      const JobGraphTemplate::NodeDesc& desc = tmpl._nodes[k];
+      const SubgraphBindings::Binding& binding = bindings._bindings[k];
+      assert(binding.inputs && "Template node has no bindings");
+
+      auto index = static_cast<uint32_t>(_slots.size());
+      JobControlBlock* control = new (&controls[n]) JobControlBlock();
+      control->flags.store(desc.flags, std::memory_order_relaxed);
+
+      auto& slot = _slots.emplace_back(_arena, std::span<GraphNodeHandle>(dependents, desc.dependents.size()));
+      dependents += desc.dependents.size();
+
+      GraphNodeHandle handle{
+          .index = index,
+          .generation = 1,
+          .jobHandle = {.id = index + 1, .generation = 1, .control = control, .system = _system},
+      };
+
+      auto* inputs = static_cast<const std::byte*>(binding.inputs);
+      auto* outputs = static_cast<std::byte*>(binding.outputs);
+      data[n] = {
+          .in = inputs + i * binding.inputStride,
+          .out = outputs ? outputs + i * binding.outputStride : nullptr,
+          .graph = this,
+          .handle = handle,
+      };
+
+      slot.job.fn = desc.run;
+      slot.job.onComplete = &JobGraph::completeBoundNode;
+      slot.job.userData = &data[n];
+      slot.job.arena = _arena;
+      slot.job.control = control;
+      slot.job.flags = desc.flags;
+      slot.job.priority = desc.priority;
+      slot.control = control;
+
+      auto dependencyCount = static_cast<uint32_t>(desc.dependencies.size());
+      slot.dependencyCount = dependencyCount;
+      slot.inDegree.store(dependencyCount, std::memory_order_relaxed);
+
+      if (desc.outputSize > 0 && data[n].out) {
+        slot.output = data[n].out;
+        slot.outputSize = desc.outputSize;
+        if (_memoize) allocateMemoOutput(slot);
+      }
+    }
+
+    // Wire the instance once all of its slots exist
+    uint32_t base = instances.firstIndex + static_cast<uint32_t>(i) * nodeCount;
+    for (uint32_t k = 0; k < nodeCount; ++k) {
+      for (uint32_t dependent : tmpl._nodes[k].dependents) {
+        _slots[base + k].dependents.push_back(handleFor(base + dependent));
+      }
+      if (tmpl._nodes[k].dependencies.empty()) {
+        for (GraphNodeHandle dep : after) {
+          assert(dep.index < _slots.size());
+          _slots[dep.index].dependents.push_back(handleFor(base + k));
+          ++_slots[base + k].dependencyCount;
+          _slots[base + k].inDegree.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+
+  return instances;
+}
+
+GraphNodeHandle JobGraph::instanceNode(const SubgraphInstances& instances, size_t instance, uint32_t templateNode) const {
+  assert(instance < instances.count && templateNode < instances.nodesPerInstance);
+  return handleFor(instances.firstIndex + static_cast<uint32_t>(instance) * instances.nodesPerInstance + templateNode);
+}
+
+void JobGraph::completeBoundNode(void* userData) {
+  auto* d = static_cast<BoundNodeData*>(userData);
+  d->graph->onJobComplete(d->handle, *d->graph->_system);
+}
+
+GraphNodeHandle JobGraph::addSubgraph(JobGraph& child) {
+  assert(&child != this && !child._parent && "A graph can only be embedded once");
+  assert(child._system == _system && "Subgraphs must run on the same JobSystem");
+
+  GraphNodeHandle handle = createSlot();
+  auto& slot = _slots[handle.index];
+  child._parent = this;
+  child._parentNode = handle.index;
+
+  auto* nodeData = _arena->allocate<SubgraphNodeData>();
+  assert(nodeData && "Arena out of memory");
+  *nodeData = {this, &child, handle};
+
+  // Completes when the child does, like I/O nodes
+  slot.subgraph = &child;
+  slot.job.fn = &JobGraph::startSubgraph;
+  slot.job.userData = nodeData;
+  slot.job.arena = _arena;
+  slot.job.control = nullptr;
+  slot.job.flags = JobFlags::Cancelable;
+
+  return handle;
+}
+
+void JobGraph::startSubgraph(void* userData) {
+  auto* data = static_cast<SubgraphNodeData*>(userData);
+  JobControlBlock* control = data->handle.jobHandle.control;
+
+  // Pairs with cancel(): either it sees the node running and cancels the
+  // child's nodes, or we see the request here and skip the child
+  control->state.store(JobState::Running);
+  if (control->cancelRequested.load() || data->child->_slots.size() == 0) {
+    data->graph->completeSubgraph(data->handle.index);
+    return;
+  }
+  data->child->submitReadyJobs();
+}
+
+void JobGraph::completeSubgraph(uint32_t index) {
+  // The child's outputs aren't tracked, dependents must assume they changed
+  if (_memoize) {
+    _slots[index].outputFingerprint = hashMix(_changeCounter.fetch_add(1, std::memory_order_relaxed) + 1);
+  }
+  completeNode(handleFor(index));
+}
+
+void JobGraph::cancelAllNodes() {
+  for (uint32_t i = 0; i < _slots.size(); ++i) {
+    if (_slots[i].dependencyCount == 0) {
+      cancel(handleFor(i));
+    }
+  }
+}
+
 void JobGraph::setDependencies(GraphNodeHandle node, std::initializer_list<GraphNodeHandle> deps) {
   assert(node.index < _slots.size());
   JobGraphNodeSlot& slot = _slots[node.index];
   slot.inDegree = static_cast<uint32_t>(deps.size());
+  slot.dependencyCount = static_cast<uint32_t>(deps.size());
 
   for (auto dep : deps) {
     assert(dep.index < _slots.size());
@@ -15,37 +417,379 @@ void JobGraph::setDependencies(GraphNodeHandle node, std::initializer_list<Graph
   }
 }
 
+void JobGraph::setFlags(GraphNodeHandle node, JobFlags flags) {
+  assert(node.index < _slots.size());
+  auto& slot = _slots[node.index];
+  slot.job.flags = flags;
+  // Submitting copies them too, but JobSystem::cancel may look before the node is dispatched
+  slot.control->flags.store(flags, std::memory_order_relaxed);
+}
+
+void JobGraph::cancel(GraphNodeHandle node) {
+  assert(node.index < _slots.size());
+
+  std::vector<uint32_t> pending{node.index};
+  std::vector<bool> passed;  // Non-cancelable nodes already walked through, sized on first use
+  while (!pending.empty()) {
+    uint32_t index = pending.back();
+    pending.pop_back();
+
+    JobGraphNodeSlot& slot = _slots[index];
+    if (HasFlag(slot.control->flags.load(std::memory_order_relaxed), JobFlags::Cancelable)) {
+      // Already flagged means its subgraph was (or is being) flagged too
+      if (slot.control->cancelRequested.exchange(true)) {
+        continue;
+      }
+      if (slot.subgraph && slot.control->state.load() == JobState::Running) {
+        slot.subgraph->cancelAllNodes();
+      }
+    } else {
+      // Runs like JobSystem::cancel would leave it, cancelable nodes below it are still flagged
+      if (passed.empty()) passed.resize(_slots.size());
+      if (passed[index]) continue;
+      passed[index] = true;
+    }
+    for (GraphNodeHandle dep : slot.dependents) {
+      pending.push_back(dep.index);
+    }
+  }
+}
+
+GraphNodeHandle JobGraph::handleFor(uint32_t index) const {
+  assert(index < _slots.size());
+  return GraphNodeHandle{
+      .index = index,
+      .generation = _slots[index].generation,
+      .jobHandle = {.id = index + 1, .generation = _slots[index].generation, .control = _slots[index].control, .system = _system},
+  };
+}
+
+bool JobGraph::skipIfCancelled(JobGraphNodeSlot& slot) {
+  if (!slot.control->cancelRequested.load(std::memory_order_acquire)) {
+    return false;
+  }
+  _system->finish(*slot.control, JobState::Cancelled);
+  return true;
+}
+
+void JobGraph::setAffinity(GraphNodeHandle node, uint32_t workerGroup, uint32_t worker) {
+  assert(node.index < _slots.size());
+  Job& job = _slots[node.index].job;
+  job.flags |= JobFlags::WorkerAffinity;
+  _slots[node.index].control->flags.store(job.flags, std::memory_order_relaxed);
+  job.workerGroup = workerGroup;
+  job.worker = worker;
+}
+
+void JobGraph::setPriority(GraphNodeHandle node, JobPriority priority) {
+  assert(node.index < _slots.size());
+  _slots[node.index].job.priority = priority;
+}
+
+void JobGraph::setDeadline(GraphNodeHandle node, uint64_t deadline) {
+  assert(node.index < _slots.size());
+  _slots[node.index].job.deadline = deadline;
+  if (deadline != 0) {
+    unfuse(node.index);
+  }
+}
+
 void JobGraph::reset() {
   _slots.clear();
 }
 
 void JobGraph::submitReadyJobs() {
-  for (auto& slot : _slots) {
+  if (_submitted) {
+    rearm();
+  }
+  _submitted = true;
+  _pendingNodes.store(static_cast<uint32_t>(_slots.size()), std::memory_order_release);
+
+  for (uint32_t i = 0; i < _slots.size(); ++i) {
+    auto& slot = _slots[i];
     if (slot.inDegree == 0 && !slot.scheduled) {
-      _system->submit(slot.job);
       slot.scheduled = true;
+      if (skipIfCancelled(slot)) {
+        releaseDependents(handleFor(i), *_system, true);
+      } else {
+        dispatch(i, *_system);
+      }
     }
   }
 }
 
+// Requires every node of the previous run to have completed
+void JobGraph::rearm() {
+  for (auto& slot : _slots) {
+    slot.inDegree.store(slot.dependencyCount, std::memory_order_relaxed);
+    slot.scheduled.store(false, std::memory_order_relaxed);
+    slot.control->state.store(JobState::Pending, std::memory_order_relaxed);
+    slot.control->cancelRequested.store(false, std::memory_order_relaxed);
+    slot.control->reopenContinuations();
+    slot.upstreamFingerprint.store(0, std::memory_order_relaxed);
+  }
+}
+
+void JobGraph::dispatch(uint32_t index, JobSystem& system) {
+  JobGraphNodeSlot& slot = _slots[index];
+  if (!slot.chain) {
+    system.submit(slot.job);
+    return;
+  }
+
+  // Members keep their own control blocks, the chain job only drives them
+  Job job = slot.job;
+  job.fn = &JobGraph::runChain;
+  job.onComplete = nullptr;
+  job.userData = slot.chain;
+  job.control = nullptr;
+  system.submit(job);
+}
+
+void JobGraph::runChain(void* userData) {
+  auto* chain = static_cast<FusedChain*>(userData);
+  JobGraph& graph = *chain->graph;
+  JobSystem& system = *graph._system;
+
+  // Each member's onComplete releases the next member without queueing it
+  // (it's fusedInner), the loop picks it up right here instead.
+  uint32_t index = chain->head;
+  while (index != JobGraphNodeSlot::NoNode) {
+    JobGraphNodeSlot& slot = graph._slots[index];
+    uint32_t next = slot.fusedNext;
+    Job job = slot.job;
+    system.execute(job);
+    index = next;
+  }
+}
+
 void JobGraph::onJobComplete(GraphNodeHandle node, JobSystem& system) {
+  releaseDependents(node, system, false);
+}
+
+// `nodeSkipped`: the node was finished by skipIfCancelled instead of running
+void JobGraph::releaseDependents(GraphNodeHandle node, JobSystem& system, bool nodeSkipped) {
   assert(node.index < _slots.size());
-  JobGraphNodeSlot& slot = _slots[node.index];
 
-  for (GraphNodeHandle dep : slot.dependents) {
-    assert(dep.index < _slots.size());
-    JobGraphNodeSlot& depSlot = _slots[dep.index];
+  // Cancelled dependents are completed right here instead of being queued,
+  // so skipping a subgraph costs O(descendants) and never touches a queue.
+  // Only allocates when there's a cancelled subgraph to walk.
+  std::vector<uint32_t> skipped;
+  uint32_t current = node.index;
+  bool currentRan = !nodeSkipped;
+  uint32_t completed = 0;
+
+  while (true) {
+    ++completed;
+    for (GraphNodeHandle dep : _slots[current].dependents) {
+      assert(dep.index < _slots.size());
+      JobGraphNodeSlot& depSlot = _slots[dep.index];
+
+      // Published to the dependent by the in-degree decrement below
+      if (_memoize) {
+        uint64_t contribution = hashCombine(current, _slots[current].outputFingerprint);
+        depSlot.upstreamFingerprint.fetch_add(contribution, std::memory_order_relaxed);
+      }
 
-    uint32_t prev = depSlot.inDegree.fetch_sub(1, std::memory_order_acq_rel);
-    assert(prev > 0);
+      uint32_t prev = depSlot.inDegree.fetch_sub(1, std::memory_order_acq_rel);
+      assert(prev > 0);
 
-    if (prev == 1) {
-      bool expected = false;
-      if (depSlot.scheduled.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
-        system.submit(depSlot.job);
+      if (prev == 1) {
+        bool expected = false;
+        if (depSlot.scheduled.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+          if (depSlot.fusedInner && currentRan) {
+            // Its chain predecessor (the only dependency) runs it next on this worker
+            continue;
+          }
+          if (skipIfCancelled(depSlot)) {
+            skipped.push_back(dep.index);
+          } else {
+            dispatch(dep.index, system);
+          }
+        }
       }
     }
+
+    if (skipped.empty()) break;
+    current = skipped.back();
+    currentRan = false;
+    skipped.pop_back();
+  }
+
+  uint32_t remaining = _pendingNodes.fetch_sub(completed, std::memory_order_acq_rel) - completed;
+  if (remaining == 0) {
+    // Either callback may let the owner destroy this graph
+    JobGraph* parent = _parent;
+    uint32_t parentNode = _parentNode;
+    if (_onComplete) {
+      _onComplete(node, _onCompleteUserData);
+    }
+    if (parent) {
+      parent->completeSubgraph(parentNode);
+    }
+  }
+}
+
+size_t JobGraph::fuseChains(const GraphFusionOptions& options) {
+  for (auto& slot : _slots) {
+    slot.fusedNext = JobGraphNodeSlot::NoNode;
+    slot.fusedInner = false;
+    slot.chain = nullptr;
+  }
+
+  // Every node has at most one fused successor (its only dependent) and one
+  // fused predecessor (its only dependency), so the links form disjoint chains
+  size_t links = 0;
+  for (auto& slot : _slots) {
+    if (slot.dependents.size() != 1 || !isFusable(slot, options)) continue;
+
+    uint32_t nextIndex = slot.dependents[0].index;
+    JobGraphNodeSlot& next = _slots[nextIndex];
+    if (next.dependencyCount != 1 || !isFusable(next, options)) continue;
+
+    slot.fusedNext = nextIndex;
+    next.fusedInner = true;
+    ++links;
+  }
+
+  // Inner members get one too: when their predecessor is skipped they're
+  // dispatched on their own and run the rest of the chain from there
+  for (uint32_t i = 0; i < _slots.size(); ++i) {
+    auto& slot = _slots[i];
+    if (slot.fusedNext != JobGraphNodeSlot::NoNode) {
+      slot.chain = _arena->allocate<FusedChain>();
+      assert(slot.chain && "Arena out of memory");
+      *slot.chain = {this, i};
+    }
+  }
+  return links;
+}
+
+// Takes a node out of its fused chain, the members before and after it keep running as chains of their own
+void JobGraph::unfuse(uint32_t index) {
+  JobGraphNodeSlot& slot = _slots[index];
+  if (slot.fusedInner) {
+    for (auto& previous : _slots) {
+      if (previous.fusedNext != index) continue;
+      previous.fusedNext = JobGraphNodeSlot::NoNode;
+      previous.chain = nullptr;
+      break;
+    }
+    slot.fusedInner = false;
+  }
+  if (slot.fusedNext != JobGraphNodeSlot::NoNode) {
+    _slots[slot.fusedNext].fusedInner = false;
+    slot.fusedNext = JobGraphNodeSlot::NoNode;
+    slot.chain = nullptr;
+  }
+}
+
+bool JobGraph::isFusable(const JobGraphNodeSlot& slot, const GraphFusionOptions& options) const {
+  // Nodes without a job control block complete themselves (I/O) and can't run inline
+  if (!slot.job.control) return false;
+  if (HasFlag(slot.job.flags, JobFlags::LongRunning) || HasFlag(slot.job.flags, JobFlags::WorkerAffinity)) return false;
+  // The scheduler only sees the chain job, a member's deadline would go unnoticed
+  if (slot.job.deadline != 0) return false;
+
+  uint64_t cost = slot.costHint ? slot.costHint : slot.measuredCost.load(std::memory_order_relaxed);
+  if (cost == 0) return options.fuseUnknownCost;
+  return cost <= static_cast<uint64_t>(options.costThreshold.count());
+}
+
+void JobGraph::setCostHint(GraphNodeHandle node, std::chrono::nanoseconds cost) {
+  assert(node.index < _slots.size());
+  _slots[node.index].costHint = static_cast<uint64_t>(cost.count());
+}
+
+void JobGraph::setProfiling(bool enabled) { _profiling = enabled; }
+
+std::chrono::nanoseconds JobGraph::measuredCost(GraphNodeHandle node) const {
+  assert(node.index < _slots.size());
+  return std::chrono::nanoseconds(_slots[node.index].measuredCost.load(std::memory_order_relaxed));
+}
+
+void JobGraph::recordCost(uint32_t index, uint64_t nanoseconds) {
+  // Moving average weighted 3:1 towards history, seeded by the first sample
+  auto& measured = _slots[index].measuredCost;
+  uint64_t previous = measured.load(std::memory_order_relaxed);
+  uint64_t next = previous == 0 ? nanoseconds : (previous * 3 + nanoseconds) / 4;
+  measured.store(next == 0 ? 1 : next, std::memory_order_relaxed);
+}
+
+void JobGraph::setMemoization(bool enabled) {
+  _memoize = enabled;
+  for (auto& slot : _slots) {
+    slot.memoValid = false;
+    if (enabled) allocateMemoOutput(slot);
+  }
+}
+
+void JobGraph::allocateMemoOutput(JobGraphNodeSlot& slot) {
+  if (slot.outputSize == 0 || slot.memoOutput) return;
+  slot.memoOutput = _arena->allocateRaw(slot.outputSize, alignof(std::max_align_t));
+  assert(slot.memoOutput && "Arena out of memory");
+}
+
+void JobGraph::setInputVersion(GraphNodeHandle node, uint64_t version) {
+  assert(node.index < _slots.size());
+  assert(version != 0 && "Version 0 means unversioned");
+  _slots[node.index].inputVersion = version;
+}
+
+void JobGraph::invalidate(GraphNodeHandle node) {
+  assert(node.index < _slots.size());
+  _slots[node.index].memoValid = false;
+}
+
+GraphMemoStats JobGraph::memoStats() const {
+  return {_memoHits.load(std::memory_order_relaxed), _memoMisses.load(std::memory_order_relaxed)};
+}
+
+// Runs on the node's worker before Node::run, true when the run can be skipped
+bool JobGraph::tryReuseOutput(uint32_t index, bool hasInputFingerprint, uint64_t inputFingerprint) {
+  JobGraphNodeSlot& slot = _slots[index];
+  if (slot.inputVersion != 0) {
+    inputFingerprint = hashCombine(inputFingerprint, slot.inputVersion);
+  } else if (!hasInputFingerprint) {
+    return false;
+  }
+
+  uint64_t key = hashCombine(inputFingerprint, slot.upstreamFingerprint.load(std::memory_order_relaxed));
+  if (slot.memoValid && slot.memoKey == key) {
+    if (slot.outputSize > 0) {
+      std::memcpy(slot.output, slot.memoOutput, slot.outputSize);
+    }
+    _memoHits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  slot.memoKey = key;
+  slot.memoValid = false;
+  _memoMisses.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+// Runs on the node's worker after Node::run
+void JobGraph::storeOutput(uint32_t index, bool memoizable) {
+  JobGraphNodeSlot& slot = _slots[index];
+  memoizable = memoizable || slot.inputVersion != 0;
+
+  if (slot.outputSize > 0) {
+    slot.outputFingerprint = hashBytes(slot.output, slot.outputSize);
+  } else if (memoizable) {
+    slot.outputFingerprint = slot.memoKey;
+  } else {
+    // Nothing to compare, dependents must assume it changed
+    slot.outputFingerprint = hashMix(_changeCounter.fetch_add(1, std::memory_order_relaxed) + 1);
+  }
+
+  // A cancelled run may have stopped half way, don't cache what it left behind
+  if (!memoizable || slot.control->cancelRequested.load(std::memory_order_acquire)) return;
+
+  if (slot.outputSize > 0) {
+    std::memcpy(slot.memoOutput, slot.output, slot.outputSize);
   }
+  slot.memoValid = true;
 }
 
 void JobGraph::setOnGraphComplete(OnGraphCompleteFn fn, void* userData) {
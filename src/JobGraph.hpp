@@ -1,24 +1,84 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <initializer_list>
 #include <span>
+#include <type_traits>
 #include <utility>
 
 #include "ArenaVector.hpp"
+#include "Hash.hpp"
+#include "IoService.hpp"
 #include "Job.hpp"
 #include "JobGraphNode.hpp"
 #include "JobSystem.hpp"
 
+struct FusedChain;
+class JobGraph;
+class JobGraphTemplate;
+class SubgraphBindings;
+
 struct JobGraphNodeSlot {
-  JobGraphNodeSlot(FrameArena* arena) : dependents(arena, 2), inDegree(0), generation(0), scheduled(false) {}
+  static constexpr uint32_t NoNode = UINT32_MAX;
+
+  JobGraphNodeSlot(FrameArena* arena) : dependents(arena, 2), inDegree(0), generation(1), scheduled(false) {}
+
+  // Dependents start out in `dependentStorage`, see JobGraph::instantiate()
+  JobGraphNodeSlot(FrameArena* arena, std::span<GraphNodeHandle> dependentStorage)
+      : dependents(arena, dependentStorage.data(), dependentStorage.size()), inDegree(0), generation(1), scheduled(false) {}
 
   Job job;
+  JobControlBlock* control = nullptr;  // Same as job.control, except for nodes that complete themselves (I/O, subgraphs)
   ArenaVector<GraphNodeHandle> dependents;
   std::atomic<uint32_t> inDegree = 0;  // Number of inputs that must run before this node runs
+  uint32_t dependencyCount = 0;        // inDegree before the graph runs, restored when it is submitted again
   uint32_t generation = 1;             // Lines up with the handle generation
   std::atomic<bool> scheduled = false;
+  JobGraph* subgraph = nullptr;  // Set on nodes added by JobGraph::addSubgraph()
+
+  // Chain fusion, see JobGraph::fuseChains()
+  uint32_t fusedNext = NoNode;  // Runs right after this node, on the same worker
+  bool fusedInner = false;      // Run by its chain predecessor, unless that one was skipped as cancelled
+  FusedChain* chain = nullptr;  // Set on every member with a fusedNext, dispatching it runs the rest of the chain
+
+  uint64_t costHint = 0;                   // Nanoseconds, from setCostHint()
+  std::atomic<uint64_t> measuredCost = 0;  // Nanoseconds, moving average while profiling
+
+  // Memoization, see JobGraph::setMemoization()
+  void* output = nullptr;      // Node's output if it's trivially copyable
+  uint32_t outputSize = 0;
+  void* memoOutput = nullptr;  // Copy of the output of the last run
+  uint64_t memoKey = 0;        // Input and upstream fingerprint of the last run
+  bool memoValid = false;
+  uint64_t inputVersion = 0;   // From setInputVersion(), 0 when not versioned
+  uint64_t outputFingerprint = 0;
+  std::atomic<uint64_t> upstreamFingerprint = 0;  // Sum of the dependencies' output fingerprints
+};
+
+//
+//  Controls JobGraph::fuseChains(). A node's cost is its hint if it has
+//  one, otherwise its measured cost from profiled runs.
+//
+struct GraphMemoStats {
+  uint64_t hits = 0;    // Nodes skipped, output restored from the cache
+  uint64_t misses = 0;  // Memoizable nodes that had to run
+};
+
+//
+//  The nodes created by one JobGraph::instantiate() call, laid out
+//  instance by instance in template order. See JobGraph::instanceNode().
+//
+struct SubgraphInstances {
+  uint32_t firstIndex = 0;
+  uint32_t nodesPerInstance = 0;
+  uint32_t count = 0;
+};
+
+struct GraphFusionOptions {
+  std::chrono::nanoseconds costThreshold{20'000};  // Nodes estimated above this stay separate jobs
+  bool fuseUnknownCost = true;                     // Nodes without a hint or measurement count as cheap
 };
 
 class JobGraph {
@@ -30,7 +90,108 @@ class JobGraph {
   template <typename Node, typename... Args>
   GraphNodeHandle addNode(Args&&... args);
 
+  //
+  //  I/O nodes. Reads get a buffer from the graph's arena while building
+  //  the graph; the file is opened when the node becomes ready (on every
+  //  run), the read or write is issued through JobSystem::io() and the node
+  //  completes when the I/O lands, without holding a worker in between.
+  //
+  //  `size = 0` reads from `offset` to the end of the file, the buffer is
+  //  sized to the file at build time: the file has to exist by then (pass
+  //  an explicit size for files an upstream node creates) and a run that
+  //  finds it grown past the buffer fails with -ENOBUFS.
+  //  `data` for writes is read when the node runs, so it can point at an
+  //  upstream node's output. Failures (open, arena exhausted, I/O error) are
+  //  reported as -errno in the result and still complete the node.
+  //
+  GraphNodeHandle addReadFile(const char* path, ReadFileResult* out, size_t size = 0, uint64_t offset = 0);
+  GraphNodeHandle addWriteFile(const char* path, const std::span<const std::byte>* data, int64_t* bytesWritten, uint64_t offset = 0);
+
+  //
+  //  Stamps out `count` copies of a JobGraphTemplate, instance i reading and
+  //  writing through the bindings' i-th element. Control blocks, node data
+  //  and the instances' dependency lists share one arena allocation. Root
+  //  nodes of every instance (no dependencies inside the template) also
+  //  depend on `after`. Instance nodes are regular graph nodes, see
+  //  instanceNode() for their handles.
+  //
+  SubgraphInstances instantiate(const JobGraphTemplate& tmpl, size_t count, const SubgraphBindings& bindings,
+                                std::initializer_list<GraphNodeHandle> after = {});
+  GraphNodeHandle instanceNode(const SubgraphInstances& instances, size_t instance, uint32_t templateNode) const;
+
+  //
+  //  Runs `child` as a single node of this graph: once the node's
+  //  dependencies completed the child graph is submitted, and the node
+  //  completes (releasing its dependents) when the child's last node did.
+  //  Cancelling the node skips the child, or cancels the child's nodes if
+  //  it already started. The child must belong to the same JobSystem, stay
+  //  alive while this graph runs, and can only be embedded once.
+  //
+  GraphNodeHandle addSubgraph(JobGraph& child);
+
   void setDependencies(GraphNodeHandle node, std::initializer_list<GraphNodeHandle> deps);
+
+  //
+  //  Requests cancellation of `node` and everything downstream of it, each
+  //  node is visited once. Nodes that haven't started are skipped without
+  //  being queued, running nodes can poll JobSystem::isCancellationRequested().
+  //  Skipped nodes end in JobState::Cancelled. Like JobSystem::cancel only
+  //  JobFlags::Cancelable nodes (the default, see setFlags) are affected.
+  //
+  void cancel(GraphNodeHandle node);
+
+  void setFlags(GraphNodeHandle node, JobFlags flags);
+  void setAffinity(GraphNodeHandle node, uint32_t workerGroup, uint32_t worker = Job::AnyWorker);
+  void setPriority(GraphNodeHandle node, JobPriority priority);
+  void setDeadline(GraphNodeHandle node, uint64_t deadline);
+
+  //
+  //  Linear chains (A -> B -> C where each link is A's only dependent and
+  //  B's only dependency) of cheap nodes are run back to back inside a
+  //  single job on one worker, so each link skips an enqueue/dequeue and
+  //  B reads A's output while it's still hot in cache. Handles to inner
+  //  nodes keep working: every node still gets its own completion state.
+  //
+  //  Nodes that complete themselves (I/O), LongRunning and WorkerAffinity
+  //  nodes and nodes with a deadline are never fused (setDeadline() takes
+  //  an already fused node back out of its chain). Call after the graph is
+  //  built and before it is submitted; calling again re-evaluates the
+  //  chains (e.g. with measured costs after a profiled run). Returns the
+  //  number of fused links.
+  //
+  size_t fuseChains(const GraphFusionOptions& options = {});
+  void setCostHint(GraphNodeHandle node, std::chrono::nanoseconds cost);
+  void setProfiling(bool enabled);
+  std::chrono::nanoseconds measuredCost(GraphNodeHandle node) const;
+
+  //
+  //  Incremental re-runs for graphs that are submitted repeatedly. A node is
+  //  memoizable when it fingerprints its input (see HasInputFingerprint and
+  //  DeclaresMemoizable in JobGraphNode.hpp) or has an input version set.
+  //  Its key is that input fingerprint combined with the output fingerprints
+  //  of its dependencies; when the key matches the previous run the node is
+  //  skipped and its output restored from a cached copy.
+  //
+  //  Every node's output is fingerprinted by hashing it (trivially copyable
+  //  outputs only), so a node that recomputes the same result doesn't
+  //  invalidate its downstream. Nodes without a usable output fingerprint
+  //  always look changed to their dependents.
+  //
+  //  Only outputs that are trivially copyable can be restored; memoizable
+  //  nodes without one are skipped when unchanged, so their output must
+  //  live somewhere that survives between runs. Inputs must only be reached
+  //  through the fingerprinted input and declared dependencies.
+  //
+  //  Versions must be non-zero; bump a node's version whenever data it reads
+  //  outside its fingerprint changes. invalidate() forces a node to run on
+  //  the next submission.
+  //
+  void setMemoization(bool enabled);
+  void setInputVersion(GraphNodeHandle node, uint64_t version);
+  void invalidate(GraphNodeHandle node);
+  GraphMemoStats memoStats() const;
+
+  // Submitting a graph that already ran re-arms it and runs every node again
   void submitReadyJobs();
   void reset();
 
@@ -40,33 +201,91 @@ class JobGraph {
   FrameArena& frameArena();
 
  private:
+  friend class JobGraphTemplate;
+
+  // Node data of template instances, one per instance node
+  struct BoundNodeData {
+    const void* in;
+    void* out;
+    JobGraph* graph;
+    GraphNodeHandle handle;
+  };
+
+  template <typename Node, typename InputT, typename OutputT>
+  void runNode(const InputT* in, OutputT* out, uint32_t index);
+
+  template <typename Node, typename InputT, typename OutputT>
+  static void runBoundNode(void* userData);
+  static void completeBoundNode(void* userData);
+
+  GraphNodeHandle createSlot();
+  GraphNodeHandle handleFor(uint32_t index) const;
+  void completeNode(GraphNodeHandle node);
+  bool skipIfCancelled(JobGraphNodeSlot& slot);
+  void dispatch(uint32_t index, JobSystem& system);
+  void rearm();
+  void recordCost(uint32_t index, uint64_t nanoseconds);
+  bool isFusable(const JobGraphNodeSlot& slot, const GraphFusionOptions& options) const;
+  void unfuse(uint32_t index);
+  bool tryReuseOutput(uint32_t index, bool hasInputFingerprint, uint64_t inputFingerprint);
+  void storeOutput(uint32_t index, bool memoizable);
+  void allocateMemoOutput(JobGraphNodeSlot& slot);
+
+  template <typename Node, typename InputT>
+  static constexpr bool CanFingerprintInput = HasInputFingerprint<Node, InputT> || DeclaresMemoizable<Node>;
+
+  template <typename Node, typename InputT>
+  static uint64_t fingerprintInput(const InputT* input);
+
+  static void runChain(void* userData);
+  void releaseDependents(GraphNodeHandle node, JobSystem& system, bool nodeSkipped);
+
+  static void startFileIo(void* userData);
+  static void finishFileIo(void* userData);
+
+  static void startSubgraph(void* userData);
+  void completeSubgraph(uint32_t index);
+  void cancelAllNodes();
+
   FrameArena* _arena = nullptr;
   JobSystem* _system = nullptr;
   ArenaVector<JobGraphNodeSlot> _slots;
 
   OnGraphCompleteFn _onComplete = nullptr;
   void* _onCompleteUserData = nullptr;
+
+  std::atomic<uint32_t> _pendingNodes = 0;
+  bool _submitted = false;
+  bool _profiling = false;
+  bool _memoize = false;
+
+  std::atomic<uint64_t> _memoHits = 0;
+  std::atomic<uint64_t> _memoMisses = 0;
+  std::atomic<uint64_t> _changeCounter = 0;
+
+  // Set when this graph is embedded in another one, see addSubgraph()
+  JobGraph* _parent = nullptr;
+  uint32_t _parentNode = 0;
 };
 
+template <typename Node, typename InputT>
+uint64_t JobGraph::fingerprintInput(const InputT* input) {
+  if constexpr (HasInputFingerprint<Node, InputT>) {
+    return Node::fingerprint(input);
+  } else if constexpr (DeclaresMemoizable<Node>) {
+    static_assert(std::is_trivially_copyable_v<InputT>, "Memoizable nodes with non trivially copyable inputs need a fingerprint()");
+    return hashBytes(input, sizeof(InputT));
+  } else {
+    return 0;
+  }
+}
+
 template <typename Node, typename... Args>
 GraphNodeHandle JobGraph::addNode(Args&&... args) {
   static_assert(sizeof...(Args) == 1 || sizeof...(Args) == 2);
 
-  _slots.emplace_back(_arena);
-  auto& slot = _slots.back();
-
-  auto* control = _arena->allocate<JobControlBlock>();
-  control->state.store(JobState::Pending);
-  control->cancelRequested.store(false);
-  slot.job.control = control;
-
-  JobHandle jobHandle{.id = static_cast<uint32_t>(_slots.size()), .generation = 1, .control = control};
-
-  GraphNodeHandle handle{
-      .index = static_cast<uint32_t>(_slots.size() - 1),
-      .generation = 1,
-      .jobHandle = jobHandle,
-  };
+  GraphNodeHandle handle = createSlot();
+  auto& slot = _slots[handle.index];
 
   using Tuple = std::tuple<std::decay_t<Args>...>;
   using InputT = std::decay_t<std::remove_pointer_t<std::tuple_element_t<0, Tuple>>>;
@@ -91,12 +310,15 @@ GraphNodeHandle JobGraph::addNode(Args&&... args) {
     auto* data = _arena->allocate<JobData>();
     *data = {input, output, _arena, _system, this, handle};
 
+    if constexpr (std::is_trivially_copyable_v<OutputT>) {
+      slot.output = output;
+      slot.outputSize = sizeof(OutputT);
+      if (_memoize) allocateMemoOutput(slot);
+    }
+
     slot.job.fn = [](void* userData) {
       auto* d = static_cast<JobData*>(userData);
-      Node::run(d->in, d->out, d->arena);
-      if (d->handle.jobHandle.isValid()) {
-        d->handle.jobHandle.control->state.store(JobState::Completed, std::memory_order_release);
-      }
+      d->graph->template runNode<Node>(d->in, d->out, d->handle.index);
     };
     slot.job.onComplete = [](void* userData) {
       auto* d = static_cast<JobData*>(userData);
@@ -104,7 +326,7 @@ GraphNodeHandle JobGraph::addNode(Args&&... args) {
     };
     slot.job.userData = data;
     slot.job.arena = _arena;
-    slot.job.flags = JobFlags::None;
+    slot.job.flags = JobFlags::Cancelable;
 
   } else {
     static_assert(sizeof...(Args) == 1);
@@ -125,10 +347,7 @@ GraphNodeHandle JobGraph::addNode(Args&&... args) {
 
     slot.job.fn = [](void* userData) {
       auto* d = static_cast<JobData*>(userData);
-      Node::run(d->in, d->arena);
-      if (d->handle.jobHandle.isValid()) {
-        d->handle.jobHandle.control->state.store(JobState::Completed, std::memory_order_release);
-      }
+      d->graph->template runNode<Node, InputT, void>(d->in, nullptr, d->handle.index);
     };
     slot.job.onComplete = [](void* userData) {
       auto* d = static_cast<JobData*>(userData);
@@ -136,8 +355,35 @@ GraphNodeHandle JobGraph::addNode(Args&&... args) {
     };
     slot.job.userData = data;
     slot.job.arena = _arena;
-    slot.job.flags = JobFlags::None;
+    slot.job.flags = JobFlags::Cancelable;
   }
 
   return handle;
-}
\ No newline at end of file
+}
+
+template <typename Node, typename InputT, typename OutputT>
+void JobGraph::runNode(const InputT* in, OutputT* out, uint32_t index) {
+  constexpr bool fingerprinted = CanFingerprintInput<Node, InputT>;
+
+  if (_memoize && tryReuseOutput(index, fingerprinted, fingerprinted ? fingerprintInput<Node>(in) : 0)) {
+    return;
+  }
+
+  uint64_t start = _profiling ? JobSystem::clockNow() : 0;
+  if constexpr (std::is_void_v<OutputT>) {
+    Node::run(in, _arena);
+  } else {
+    Node::run(in, out, _arena);
+  }
+  if (_profiling) {
+    recordCost(index, JobSystem::clockNow() - start);
+  }
+
+  if (_memoize) storeOutput(index, fingerprinted);
+}
+
+template <typename Node, typename InputT, typename OutputT>
+void JobGraph::runBoundNode(void* userData) {
+  auto* d = static_cast<BoundNodeData*>(userData);
+  d->graph->template runNode<Node>(static_cast<const InputT*>(d->in), static_cast<OutputT*>(d->out), d->handle.index);
+}
@@ -56,4 +56,26 @@ concept IsJobGraphNodeNoOutput = requires(const In* in, FrameArena* arena) {
 //  Unified concept
 //
 template <typename T, typename In, typename Out = void>
-concept IsJobGraphNode = IsJobGraphNodeWithOutput<T, In, Out> || IsJobGraphNodeNoOutput<T, In>;
\ No newline at end of file
+concept IsJobGraphNode = IsJobGraphNodeWithOutput<T, In, Out> || IsJobGraphNodeNoOutput<T, In>;
+
+//
+//  Memoization, see JobGraph::setMemoization(). A node opts in by either
+//  hashing its own input:
+//
+//      static uint64_t fingerprint(const In* input);
+//
+//  or, for trivially copyable inputs, by declaring
+//
+//      static constexpr bool Memoizable = true;
+//
+//  in which case the input bytes are hashed.
+//
+template <typename T, typename In>
+concept HasInputFingerprint = requires(const In* in) {
+  { T::fingerprint(in) } -> std::convertible_to<uint64_t>;
+};
+
+template <typename T>
+concept DeclaresMemoizable = requires {
+  requires T::Memoizable;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Job.hpp"
+#include "JobGraph.hpp"
+#include "JobGraphNode.hpp"
+
+struct TemplateNodeRef {
+  uint32_t index = 0;
+};
+
+// Typed so bindings can be checked against the node's input and output
+template <typename In, typename Out = void>
+struct TemplateNode : TemplateNodeRef {};
+
+//
+//  The shape of a sub-DAG that's built many times with different data,
+//  e.g. the per-chunk stages of a physics step:
+//
+//      JobGraphTemplate step;
+//      auto integrate = step.addNode<Integrate, Chunk, Bounds>();
+//      auto collide = step.addNode<Collide, Bounds, Contacts>();
+//      step.setDependencies(collide, {integrate});
+//
+//      SubgraphBindings bindings(step);
+//      bindings.bind(integrate, chunks.data(), bounds.data());
+//      bindings.bind(collide, bounds.data(), contacts.data());
+//      graph.instantiate(step, chunkCount, bindings);
+//
+//  A template holds no data and isn't tied to a graph or arena, build it
+//  once and instantiate it into as many graphs as needed.
+//
+class JobGraphTemplate {
+ public:
+  template <typename Node, typename In, typename Out = void>
+  TemplateNode<In, Out> addNode() {
+    if constexpr (std::is_void_v<Out>) {
+      static_assert(IsJobGraphNodeNoOutput<Node, In>);
+    } else {
+      static_assert(IsJobGraphNodeWithOutput<Node, In, Out>);
+    }
+
+    NodeDesc desc;
+    desc.run = &JobGraph::runBoundNode<Node, In, Out>;
+    if constexpr (!std::is_void_v<Out>) {
+      if constexpr (std::is_trivially_copyable_v<Out>) {
+        desc.outputSize = sizeof(Out);
+      }
+    }
+    _nodes.push_back(std::move(desc));
+
+    TemplateNode<In, Out> node;
+    node.index = static_cast<uint32_t>(_nodes.size() - 1);
+    return node;
+  }
+
+  void setDependencies(TemplateNodeRef node, std::initializer_list<TemplateNodeRef> deps) {
+    assert(node.index < _nodes.size());
+    NodeDesc& desc = _nodes[node.index];
+    for (uint32_t dep : desc.dependencies) {
+      std::erase(_nodes[dep].dependents, node.index);
+      --_edgeCount;
+    }
+    desc.dependencies.clear();
+
+    for (TemplateNodeRef dep : deps) {
+      assert(dep.index < _nodes.size() && dep.index != node.index);
+      desc.dependencies.push_back(dep.index);
+      _nodes[dep.index].dependents.push_back(node.index);
+      ++_edgeCount;
+    }
+  }
+
+  void setFlags(TemplateNodeRef node, JobFlags flags) {
+    assert(node.index < _nodes.size());
+    _nodes[node.index].flags = flags;
+  }
+
+  void setPriority(TemplateNodeRef node, JobPriority priority) {
+    assert(node.index < _nodes.size());
+    _nodes[node.index].priority = priority;
+  }
+
+  size_t nodeCount() const { return _nodes.size(); }
+  size_t edgeCount() const { return _edgeCount; }
+
+ private:
+  friend class JobGraph;
+
+  struct NodeDesc {
+    Job::JobFn run = nullptr;
+    uint32_t outputSize = 0;  // Trivially copyable outputs only, for memoization
+    JobFlags flags = JobFlags::Cancelable;
+    JobPriority priority = JobPriority::Normal;
+    std::vector<uint32_t> dependencies;
+    std::vector<uint32_t> dependents;
+  };
+
+  std::vector<NodeDesc> _nodes;
+  size_t _edgeCount = 0;
+};
+
+//
+//  Where each template node reads and writes, per instance. Instance i of
+//  a node uses `inputs + i * inputStride` and `outputs + i * outputStride`
+//  (in bytes, defaulting to the element size). A stride of 0 shares one
+//  object between all instances, e.g. read-only parameters.
+//
+class SubgraphBindings {
+ public:
+  explicit SubgraphBindings(const JobGraphTemplate& tmpl) : _bindings(tmpl.nodeCount()) {}
+
+  template <typename In, typename Out>
+  void bind(TemplateNode<In, Out> node, const In* inputs, Out* outputs, size_t inputStride = sizeof(In),
+            size_t outputStride = sizeof(Out)) {
+    assert(node.index < _bindings.size());
+    _bindings[node.index] = {inputs, outputs, inputStride, outputStride};
+  }
+
+  template <typename In>
+  void bind(TemplateNode<In, void> node, const In* inputs, size_t inputStride = sizeof(In)) {
+    assert(node.index < _bindings.size());
+    _bindings[node.index] = {inputs, nullptr, inputStride, 0};
+  }
+
+  size_t nodeCount() const { return _bindings.size(); }
+
+ private:
+  friend class JobGraph;
+
+  struct Binding {
+    const void* inputs = nullptr;
+    void* outputs = nullptr;
+    size_t inputStride = 0;
+    size_t outputStride = 0;
+  };
+
+  std::vector<Binding> _bindings;
+};
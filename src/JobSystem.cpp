@@ -1,61 +1,210 @@
 #include "JobSystem.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 #include "JobGraph.hpp"
+#include "ThreadAffinity.hpp"
+
+static thread_local WorkerThread* t_currentWorker = nullptr;
+static thread_local JobControlBlock* t_currentControl = nullptr;
 
 void WorkerThread::run() {
+  t_currentWorker = this;
   ThreadArenaRegistry::set(&localArena);
+  ThreadAffinity::setCurrentThreadName(name);
+  if (!cpus.empty()) {
+    ThreadAffinity::pinCurrentThread(cpus);
+  }
 
-  while (running) {
-    Job job;
+  // Fault the committed part of the arena in from the pinned thread so
+  // first-touch places it on this worker's node even when mbind wasn't
+  // available. The queue below arenaBase is already in use by submitters.
+  localArena.prefault(arenaBase);
 
-    if (queue.try_dequeue(job)) {
-      if (job.fn) {
-        job.fn(job.userData);
-      }
-      if (job.control) {
-        std::cout << "[JobSystem] job finished and has a controlblock\n";
-        bool wasCancelled = job.control->cancelRequested.load(std::memory_order_relaxed);
-        JobState newState = wasCancelled ? JobState::Cancelled : JobState::Completed;
-        job.control->state.store(newState, std::memory_order_release);
-      }
-      if (job.onComplete) {
-        job.onComplete(job.userData);
+  // Spin briefly when out of work so bursts don't pay for a wakeup, then
+  // sleep so an idle worker gives its core back
+  uint64_t idleStart = 0;
+  while (running.load(std::memory_order_acquire)) {
+    if (system->runPendingJob()) {
+      if (idleStart != 0) {
+        idleStart = 0;
+        idleSince.store(0, std::memory_order_relaxed);
       }
       continue;
     }
 
-    if (system && system->getNextJob(job)) {
-      if (job.fn) {
-        job.fn(job.userData);
+    uint64_t now = JobSystem::clockNow();
+    if (idleStart == 0) {
+      idleStart = now;
+      idleSince.store(now, std::memory_order_relaxed);
+    }
+    if (now - idleStart < system->_idleSpinTime) {
+      std::this_thread::yield();
+    } else {
+      system->sleepUntilWork(*this);
+    }
+  }
+
+  // Retired rather than shut down: finish what was routed here first
+  if (!accepting.load(std::memory_order_acquire)) {
+    system->drainWorker(*this);
+  }
+  idleSince.store(0, std::memory_order_relaxed);
+  ThreadArenaRegistry::clear();
+  t_currentWorker = nullptr;
+}
+
+static JobSystemConfig defaultConfig(size_t threadCount) {
+  WorkerGroupConfig group;
+  group.name = "main";
+  group.threadCount = threadCount;
+
+  JobSystemConfig config;
+  config.groups.push_back(std::move(group));
+  return config;
+}
+
+static std::vector<WorkerGroupConfig> numaGroups(const NumaTopology& topology) {
+  std::vector<WorkerGroupConfig> groups;
+  for (const auto& node : topology.nodes()) {
+    WorkerGroupConfig group;
+    group.name = "node" + std::to_string(node.id);
+    group.threadCount = node.cpus.size();
+    group.cpus = node.cpus;
+    groups.push_back(std::move(group));
+  }
+  return groups;
+}
+
+JobSystem::JobSystem(size_t threadCount) : JobSystem(defaultConfig(threadCount)) {}
+
+JobSystem::JobSystem(const JobSystemConfig& config)
+    : _frameArena(VirtualArenaConfig{.reserve = config.frameArenaReserve}, FrameArenaMode::Concurrent),
+      _longLivedArena(VirtualArenaConfig{.reserve = config.longLivedArenaReserve}, FrameArenaMode::Concurrent),
+      _internalArena(1024 * 1024),
+      _threadCount(0),
+      _topology(config.topology ? *config.topology : NumaTopology::discover()),
+      _idleSpinTime(std::chrono::duration_cast<std::chrono::nanoseconds>(config.idleSpinTime).count()),
+      _autoScaler(config.autoScaler),
+      _agingThreshold(std::chrono::duration_cast<std::chrono::nanoseconds>(config.agingThreshold).count()),
+      _frameRiskThreshold(config.frameRiskThreshold),
+      _blockingPool(this, config.blockingPool, &_internalArena),
+      _io(this, config.io) {
+  bool numa = config.numaAware && _topology.nodeCount() > 1;
+  bool bindMemory = numa && !_topology.isSimulated();
+  size_t nodeCount = numa ? _topology.nodeCount() : 1;
+
+  for (size_t n = 0; n < nodeCount; ++n) {
+    int numaNode = bindMemory ? static_cast<int>(_topology.node(n).id) : NumaMemory::AnyNode;
+    auto context = std::make_unique<NumaNodeContext>(numaNode);
+    if (numa) {
+      context->stealOrder = _topology.nodesByDistance(n);
+    } else {
+      context->stealOrder.push_back(0);
+    }
+    _nodes.emplace_back(std::move(context));
+  }
+
+  // Without explicit groups: one per node, or a single "main" group like JobSystem(threadCount)
+  std::vector<WorkerGroupConfig> groups = config.groups;
+  if (groups.empty() && numa) {
+    groups = numaGroups(_topology);
+  }
+  if (groups.empty()) {
+    groups = defaultConfig(ThreadAffinity::hardwareThreadCount()).groups;
+  }
+
+  size_t slotCount = 0;
+  for (const auto& groupConfig : groups) {
+    assert(groupConfig.threadCount > 0 && "Worker groups need at least one thread");
+    auto group = std::make_unique<WorkerGroup>();
+    group->name = groupConfig.name;
+    group->firstWorker = slotCount;
+    group->minCount = groupConfig.minThreadCount ? groupConfig.minThreadCount : groupConfig.threadCount;
+    group->capacity = std::max(groupConfig.maxThreadCount, groupConfig.threadCount);
+    group->acceptsSharedJobs = groupConfig.acceptsSharedJobs;
+    assert(group->minCount > 0 && group->minCount <= groupConfig.threadCount && "Bad worker group bounds");
+    slotCount += group->capacity;
+    _groups.emplace_back(std::move(group));
+  }
+
+  // Every slot gets its worker up front, started or not (the arena only
+  // reserves address space), so submitters never race a resize on _workers
+  size_t unpinnedCount = 0;
+  _workers.reserve(slotCount);
+  for (uint32_t g = 0; g < groups.size(); ++g) {
+    const auto& groupConfig = groups[g];
+    WorkerGroup& group = *_groups[g];
+    for (size_t i = 0; i < group.capacity; ++i) {
+      std::vector<uint32_t> cpus;
+      if (!groupConfig.cpus.empty()) {
+        if (groupConfig.spreadAcrossCpus) {
+          cpus.push_back(groupConfig.cpus[i % groupConfig.cpus.size()]);
+        } else {
+          cpus = groupConfig.cpus;
+        }
       }
-      if (job.onComplete) {
-        job.onComplete(job.userData);
+
+      size_t node = 0;
+      if (numa) {
+        if (!cpus.empty()) {
+          node = _topology.nodeOfCpu(cpus.front());
+        } else {
+          node = unpinnedCount++ % nodeCount;
+          cpus = _topology.node(node).cpus;
+        }
       }
-      continue;
+
+      int numaNode = bindMemory ? static_cast<int>(_topology.node(node).id) : NumaMemory::AnyNode;
+      auto worker = std::make_unique<WorkerThread>(config.workerArenaSize, numaNode);
+      worker->index = _workers.size();
+      worker->group = g;
+      worker->node = node;
+      worker->name = groupConfig.name + "-" + std::to_string(i);
+      worker->cpus = std::move(cpus);
+      worker->acceptsSharedJobs = groupConfig.acceptsSharedJobs;
+      worker->system = this;
+
+      _workers.emplace_back(std::move(worker));
     }
+    group.count.store(groupConfig.threadCount, std::memory_order_relaxed);
+    _threadCount.fetch_add(groupConfig.threadCount, std::memory_order_relaxed);
+  }
 
-    std::this_thread::yield();
+  // Threads start once every worker exists so affinity jobs submitted
+  // from inside a job can always resolve their target.
+  for (const auto& group : _groups) {
+    for (size_t i = 0; i < group->count; ++i) {
+      startWorker(group->firstWorker + i);
+    }
   }
-}
 
-JobSystem::JobSystem(size_t threadCount)
-    : _frameArena(1024 * 1024), _longLivedArena(1024 * 1024), _internalArena(1024 * 1024), _threadCount(threadCount), _workers(_threadCount), _globalQueue(512, &_internalArena), _highPriorityQueue(512, &_internalArena) {
-  for (size_t i = 0; i < _threadCount; ++i) {
-    auto worker = std::make_unique<WorkerThread>(512 * 1024);
-    worker->index = i;
-    worker->system = this;
-    worker->thread = std::thread([workerPtr = worker.get()]() {
-      workerPtr->run();
+  if (_autoScaler.enabled) {
+    _scalerRunning = true;
+    _scalerThread = std::thread([this]() {
+      runAutoScaler();
     });
-    _workers.emplace_back(std::move(worker));
   }
 }
 
 JobSystem::~JobSystem() {
+  if (_scalerThread.joinable()) {
+    {
+      std::lock_guard lock(_scalerMutex);
+      _scalerRunning = false;
+    }
+    _scalerWakeup.notify_all();
+    _scalerThread.join();
+  }
+
+  // I/O and blocking jobs hand their completions to the workers, so drain them first
+  _io.shutdown();
+  _blockingPool.shutdown();
+
   for (auto& worker : _workers) {
     worker->running = false;
+    wakeWorker(*worker);
   }
 
   for (auto& worker : _workers) {
@@ -64,32 +213,584 @@ JobSystem::~JobSystem() {
     }
   }
 
-  _highPriorityQueue.shutdown();
-  _globalQueue.shutdown();
+  for (auto& node : _nodes) {
+    for (auto& lane : node->lanes) {
+      lane->fifo.shutdown();
+    }
+  }
 }
 
-bool JobSystem::getNextJob(Job& out) {
-  if (_highPriorityQueue.try_dequeue(out)) {
-    return true;
+void JobSystem::execute(Job& job) {
+  // Cancelled before dispatch: skip the body but still run onComplete so
+  // whoever waits on this job (graphs included) observes it finishing
+  bool skip = job.control && job.control->cancelRequested.load(std::memory_order_acquire);
+
+  if (job.fn && !skip) {
+    if (job.control) {
+      job.control->state.store(JobState::Running, std::memory_order_relaxed);
+    }
+    JobControlBlock* previous = t_currentControl;
+    t_currentControl = job.control;
+    job.fn(job.userData);
+    t_currentControl = previous;
   }
-  if (_globalQueue.try_dequeue(out)) {
-    return true;
+  if (job.deadline != 0) {
+    if (clockNow() > job.deadline) {
+      _missedDeadlines.fetch_add(1, std::memory_order_relaxed);
+    }
+    _pendingDeadlineJobs.fetch_sub(1, std::memory_order_relaxed);
+  }
+  if (job.control) {
+    if (HasFlag(job.flags, JobFlags::DebugTrace)) {
+      std::cout << "[JobSystem] job finished and has a controlblock\n";
+    }
+    bool wasCancelled = job.control->cancelRequested.load(std::memory_order_relaxed);
+    finish(*job.control, wasCancelled ? JobState::Cancelled : JobState::Completed);
+  }
+  if (job.onComplete) {
+    job.onComplete(job.userData);
+  }
+}
+
+bool JobSystem::getNextJob(Job& out, size_t node) {
+  uint64_t now = clockNow();
+
+  // Aging: a class that hasn't been served within the threshold goes first
+  for (uint32_t p = JobPriority::High; p < JobPriority::PriorityCount; ++p) {
+    auto priority = static_cast<JobPriority>(p);
+    uint64_t lastServed = _lastServed[p].load(std::memory_order_relaxed);
+    if (lastServed >= now || now - lastServed < _agingThreshold) continue;
+
+    if (dequeueClass(priority, node, out)) {
+      markServed(priority, now);
+      return true;
+    }
+    // An empty class isn't starving
+    markServed(priority, now);
+  }
+
+  for (uint32_t p = 0; p < JobPriority::PriorityCount; ++p) {
+    auto priority = static_cast<JobPriority>(p);
+    if (dequeueClass(priority, node, out)) {
+      markServed(priority, now);
+      return true;
+    }
   }
   return false;
 }
 
-void JobSystem::submit(Job& job) {
-  if (HasFlag(job.flags, JobFlags::HighPriority)) {
-    while (!_highPriorityQueue.try_enqueue(std::move(job))) {
-      std::this_thread::yield();
+bool JobSystem::dequeueClass(JobPriority priority, size_t node, Job& out) {
+  // Local node first, then steal from the remaining nodes closest first.
+  // Deadline jobs anywhere beat FIFO jobs of the same class.
+  const auto& stealOrder = _nodes[node < _nodes.size() ? node : 0]->stealOrder;
+  for (size_t victim : stealOrder) {
+    if (_nodes[victim]->lanes[priority]->deadlines.try_pop(out)) {
+      return true;
+    }
+  }
+  for (size_t victim : stealOrder) {
+    if (_nodes[victim]->lanes[priority]->fifo.try_dequeue(out)) {
+      return true;
     }
+  }
+  return false;
+}
+
+void JobSystem::markServed(JobPriority priority, uint64_t now) {
+  // Only write when the stamp is noticeably stale to keep the line from bouncing between workers
+  auto& lastServed = _lastServed[priority];
+  uint64_t previous = lastServed.load(std::memory_order_relaxed);
+  if (now > previous && now - previous > _agingThreshold / 4) {
+    lastServed.store(now, std::memory_order_relaxed);
+  }
+}
+
+JobHandle JobSystem::submit(Job& job) {
+  JobHandle handle{.control = job.control, .system = this};
+  if (job.control) {
+    job.control->flags.store(job.flags, std::memory_order_relaxed);
+    job.control->reopenContinuations();
+  }
+  if (job.deadline != 0) {
+    _pendingDeadlineJobs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (HasFlag(job.flags, JobFlags::WorkerAffinity)) {
+    enqueueOnWorker(job);
+    return handle;
+  }
+
+  if (HasFlag(job.flags, JobFlags::LongRunning)) {
+    _blockingPool.submit(job);
+    return handle;
+  }
+
+  if (HasFlag(job.flags, JobFlags::HighPriority) && job.priority == JobPriority::Normal) {
+    job.priority = JobPriority::High;
+  }
+  assert(job.priority < JobPriority::PriorityCount);
+
+  // Jobs spawned by a worker stay on its node, external submissions are spread
+  WorkerThread* worker = t_currentWorker;
+  size_t node = worker && worker->system == this
+                    ? worker->node
+                    : _nextNode.fetch_add(1, std::memory_order_relaxed) % _nodes.size();
+  if (node >= _nodes.size()) node = 0;
+
+  PriorityLane& lane = *_nodes[node]->lanes[job.priority];
+  if (job.deadline != 0) {
+    lane.deadlines.push(job);
   } else {
-    while (!_globalQueue.try_enqueue(std::move(job))) {
+    while (!lane.fifo.try_enqueue(std::move(job))) {
       std::this_thread::yield();
     }
   }
+  wakeSharedWorker();
+  return handle;
+}
+
+JobHandle JobSystem::submitRead(IoRequest& request) {
+  request.op = IoOp::Read;
+  _io.submit(request);
+  return JobHandle{.control = request.control, .system = this};
+}
+
+JobHandle JobSystem::submitWrite(IoRequest& request) {
+  request.op = IoOp::Write;
+  _io.submit(request);
+  return JobHandle{.control = request.control, .system = this};
+}
+
+JobHandle JobHandle::then(Job& next) const {
+  assert(system && "Handle wasn't handed out by a JobSystem");
+  return system->then(*this, next);
+}
+
+namespace {
+
+// Shared state of a whenAll/whenAny, lives in the frame arena
+struct JoinState {
+  JobControlBlock control;
+  std::atomic<uint32_t> remaining;
+  JobSystem* system;
+};
+
+void arriveAll(void* userData) {
+  auto* join = static_cast<JoinState*>(userData);
+  if (join->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    join->system->finish(join->control, JobState::Completed);
+  }
 }
 
+void arriveAny(void* userData) {
+  auto* join = static_cast<JoinState*>(userData);
+  if (join->remaining.exchange(0, std::memory_order_acq_rel) != 0) {
+    join->system->finish(join->control, JobState::Completed);
+  }
+}
+
+}  // namespace
+
+JobControlBlock* JobSystem::newControlBlock() {
+  auto* control = _frameArena.allocate<JobControlBlock>();
+  assert(control && "Frame arena out of memory");
+  return new (control) JobControlBlock();
+}
+
+uint32_t JobSystem::newContinuation(const Job& job, bool runInline) {
+  uint32_t id = _continuations.acquire();
+  Continuation& continuation = _continuations.get(id);
+  continuation.job = job;
+  continuation.runInline = runInline;
+  continuation.next = 0;
+  return id;
+}
+
+JobHandle JobSystem::then(JobHandle antecedent, Job& next) {
+  assert(antecedent.isValid() && "Continuations need an antecedent with a control block");
+
+  if (!next.control) {
+    next.control = newControlBlock();
+  }
+  // Waiting on the returned handle must not see a previous run's final state
+  next.control->state.store(JobState::Pending, std::memory_order_relaxed);
+  next.control->reopenContinuations();
+
+  attach(*antecedent.control, newContinuation(next, false));
+  return JobHandle{.control = next.control, .system = this};
+}
+
+JobHandle JobSystem::whenAll(std::span<const JobHandle> handles) {
+  auto* join = _frameArena.allocate<JoinState>();
+  assert(join && "Frame arena out of memory");
+  new (join) JoinState{.control = {}, .remaining = {}, .system = this};
+
+  // One extra count keeps handles that finish while we attach from completing the join early
+  join->remaining.store(static_cast<uint32_t>(handles.size()) + 1, std::memory_order_relaxed);
+
+  Job arrive;
+  arrive.fn = &arriveAll;
+  arrive.userData = join;
+  for (const JobHandle& handle : handles) {
+    if (handle.isValid()) {
+      attach(*handle.control, newContinuation(arrive, true));
+    } else {
+      arriveAll(join);
+    }
+  }
+  arriveAll(join);
+
+  return JobHandle{.control = &join->control, .system = this};
+}
+
+JobHandle JobSystem::whenAny(std::span<const JobHandle> handles) {
+  auto* join = _frameArena.allocate<JoinState>();
+  assert(join && "Frame arena out of memory");
+  new (join) JoinState{.control = {}, .remaining = {}, .system = this};
+  join->remaining.store(1, std::memory_order_relaxed);
+
+  Job arrive;
+  arrive.fn = &arriveAny;
+  arrive.userData = join;
+  for (const JobHandle& handle : handles) {
+    if (handle.isValid()) {
+      attach(*handle.control, newContinuation(arrive, true));
+    } else {
+      arriveAny(join);
+    }
+  }
+  if (handles.empty()) {
+    arriveAny(join);
+  }
+
+  return JobHandle{.control = &join->control, .system = this};
+}
+
+void JobSystem::attach(JobControlBlock& control, uint32_t continuation) {
+  Continuation& node = _continuations.get(continuation);
+  uint32_t head = control.continuations.load(std::memory_order_acquire);
+  while (head != JobControlBlock::ContinuationsSealed) {
+    node.next = head;
+    if (control.continuations.compare_exchange_weak(head, continuation, std::memory_order_release, std::memory_order_acquire)) {
+      return;
+    }
+  }
+
+  // Already finished. finish() seals before it publishes the state, wait
+  // for that so nothing that depends on `next` can free the block under it
+  while (true) {
+    JobState state = control.state.load(std::memory_order_acquire);
+    if (state == JobState::Completed || state == JobState::Cancelled) break;
+    std::this_thread::yield();
+  }
+  node.next = 0;
+  dispatchContinuations(continuation);
+}
+
+void JobSystem::finish(JobControlBlock& control, JobState state) {
+  // Seal before publishing the state: a waiter may free the control block
+  // as soon as it sees the job finished
+  uint32_t head = control.continuations.exchange(JobControlBlock::ContinuationsSealed, std::memory_order_acq_rel);
+  assert(head != JobControlBlock::ContinuationsSealed && "Control block finished twice without being resubmitted");
+  control.state.store(state, std::memory_order_release);
+
+  if (head != 0) {
+    dispatchContinuations(head);
+  }
+}
+
+void JobSystem::dispatchContinuations(uint32_t head) {
+  // Attached LIFO, flip the list so they're dispatched in attach order
+  uint32_t ordered = 0;
+  while (head != 0) {
+    Continuation& node = _continuations.get(head);
+    uint32_t next = node.next;
+    node.next = ordered;
+    ordered = head;
+    head = next;
+  }
+
+  WorkerThread* worker = t_currentWorker;
+  bool keepLocal = worker && worker->system == this && worker->acceptsSharedJobs;
+
+  while (ordered != 0) {
+    Continuation& node = _continuations.get(ordered);
+    Job job = node.job;
+    bool runInline = node.runInline;
+    uint32_t next = node.next;
+    _continuations.release(ordered);
+    ordered = next;
+
+    if (runInline) {
+      job.fn(job.userData);
+      continue;
+    }
+
+    // Only the first one stays on this worker, the rest may spread out.
+    // Its own queue is bounded, so fall back to a regular submit when full.
+    bool local = keepLocal && job.deadline == 0 &&
+                 !HasFlag(job.flags, JobFlags::WorkerAffinity) && !HasFlag(job.flags, JobFlags::LongRunning);
+    if (local) {
+      keepLocal = false;
+      if (job.control) {
+        job.control->flags.store(job.flags, std::memory_order_relaxed);
+        job.control->reopenContinuations();
+      }
+      if (worker->queue.try_enqueue(std::move(job))) {
+        continue;
+      }
+    }
+    submit(job);
+  }
+}
+
+WorkerThread* JobSystem::resolveAffinity(const Job& job) {
+  assert(job.workerGroup < _groups.size() && "Job targets an unknown worker group");
+  WorkerGroup& group = *_groups[job.workerGroup];
+  size_t count = group.count.load(std::memory_order_seq_cst);
+
+  if (job.worker != Job::AnyWorker) {
+    assert(job.worker < group.capacity && "Job targets a worker outside of its group");
+    // Never substitute another thread for a specific worker, the job may depend on its thread bound state
+    assert(job.worker < count && "Job targets a worker that was retired by resizeGroup");
+    return job.worker < count ? _workers[group.firstWorker + job.worker].get() : nullptr;
+  }
+
+  uint32_t next = group.nextWorker.fetch_add(1, std::memory_order_relaxed);
+  return _workers[group.firstWorker + (next % count)].get();
+}
+
+void JobSystem::enqueueOnWorker(Job& job) {
+  while (true) {
+    WorkerThread* target = resolveAffinity(job);
+    if (!target) {
+      // Retired target (release builds): finish the job as cancelled rather than run it elsewhere
+      if (job.control) {
+        job.control->cancelRequested.store(true, std::memory_order_relaxed);
+      }
+      execute(job);
+      return;
+    }
+    WorkerThread& worker = *target;
+
+    // Announce ourselves before checking, the retiring worker drains until
+    // no enqueuer that saw it accepting is left
+    worker.enqueuers.fetch_add(1, std::memory_order_seq_cst);
+    if (!worker.accepting.load(std::memory_order_seq_cst)) {
+      // Retiring, the group has already shrunk so resolving again picks another worker (or fails a specific one)
+      worker.enqueuers.fetch_sub(1, std::memory_order_release);
+      continue;
+    }
+
+    while (!worker.queue.try_enqueue(std::move(job))) {
+      std::this_thread::yield();
+    }
+    worker.enqueuers.fetch_sub(1, std::memory_order_release);
+
+    // Pairs with the fence in sleepUntilWork
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker.sleeping.load(std::memory_order_relaxed) && worker.sleeping.exchange(false, std::memory_order_acq_rel)) {
+      wakeWorker(worker);
+    }
+    return;
+  }
+}
+
+void JobSystem::wakeSharedWorker() {
+  // Pairs with the fence in sleepUntilWork: either the sleeper sees the
+  // job we just queued or we see it sleeping
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (_sleepingSharedWorkers.load(std::memory_order_relaxed) == 0) return;
+
+  // Claiming the flag makes concurrent submitters wake different workers
+  for (auto& worker : _workers) {
+    if (worker->acceptsSharedJobs && worker->sleeping.load(std::memory_order_relaxed) &&
+        worker->sleeping.exchange(false, std::memory_order_acq_rel)) {
+      wakeWorker(*worker);
+      return;
+    }
+  }
+}
+
+void JobSystem::wakeWorker(WorkerThread& worker) {
+  {
+    std::lock_guard lock(worker.sleepMutex);
+    worker.wakeRequested = true;
+  }
+  worker.wakeup.notify_one();
+}
+
+void JobSystem::sleepUntilWork(WorkerThread& worker) {
+  // Bounds the cost of a missed wakeup, submitters wake sleepers explicitly
+  static constexpr auto MaxSleep = std::chrono::milliseconds(10);
+
+  worker.sleeping.store(true, std::memory_order_relaxed);
+  if (worker.acceptsSharedJobs) {
+    _sleepingSharedWorkers.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (!hasQueuedWork(worker)) {
+    std::unique_lock lock(worker.sleepMutex);
+    worker.wakeup.wait_for(lock, MaxSleep, [&worker]() {
+      return worker.wakeRequested || !worker.running.load(std::memory_order_acquire);
+    });
+    worker.wakeRequested = false;
+  }
+
+  worker.sleeping.store(false, std::memory_order_relaxed);
+  if (worker.acceptsSharedJobs) {
+    _sleepingSharedWorkers.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+bool JobSystem::hasQueuedWork(const WorkerThread& worker) const {
+  if (worker.queue.size_approx() != 0) return true;
+  if (!worker.acceptsSharedJobs) return false;
+
+  for (const auto& node : _nodes) {
+    for (const auto& lane : node->lanes) {
+      if (lane->fifo.size_approx() != 0 || !lane->deadlines.empty()) return true;
+    }
+  }
+  return false;
+}
+
+size_t JobSystem::queuedSharedJobs() const {
+  size_t queued = 0;
+  for (const auto& node : _nodes) {
+    for (const auto& lane : node->lanes) {
+      // size_approx() can briefly underflow while a dequeue races the read
+      queued += std::min(lane->fifo.size_approx(), lane->fifo.capacity()) + lane->deadlines.size_approx();
+    }
+  }
+  return queued;
+}
+
+size_t JobSystem::resizeGroup(uint32_t groupIndex, size_t count) {
+  assert(groupIndex < _groups.size());
+  std::lock_guard lock(_resizeMutex);
+
+  WorkerGroup& group = *_groups[groupIndex];
+  count = std::clamp(count, group.minCount, group.capacity);
+  size_t current = group.count.load(std::memory_order_relaxed);
+
+  while (current < count) {
+    startWorker(group.firstWorker + current);
+    group.count.store(++current, std::memory_order_seq_cst);
+    _threadCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  while (current > count) {
+    // Shrink first: submitters that find the worker no longer accepting
+    // must resolve to one of the remaining workers
+    group.count.store(--current, std::memory_order_seq_cst);
+    _threadCount.fetch_sub(1, std::memory_order_relaxed);
+    retireWorker(group.firstWorker + current);
+  }
+  return current;
+}
+
+void JobSystem::startWorker(size_t index) {
+  WorkerThread& worker = *_workers[index];
+  assert(!worker.thread.joinable());
+  worker.running.store(true, std::memory_order_relaxed);
+  worker.accepting.store(true, std::memory_order_relaxed);
+  worker.thread = std::thread([workerPtr = &worker]() {
+    workerPtr->run();
+  });
+}
+
+void JobSystem::retireWorker(size_t index) {
+  WorkerThread& worker = *_workers[index];
+  assert(t_currentWorker != &worker && "A worker can't retire itself");
+
+  worker.accepting.store(false, std::memory_order_seq_cst);
+  worker.running.store(false, std::memory_order_release);
+  wakeWorker(worker);
+  worker.thread.join();
+}
+
+void JobSystem::drainWorker(WorkerThread& worker) {
+  // Affinity jobs already routed here and their continuations still run on
+  // this worker. The queue is only empty for good once no enqueuer is mid-push.
+  Job job;
+  while (true) {
+    if (worker.queue.try_dequeue(job)) {
+      execute(job);
+      continue;
+    }
+    if (worker.enqueuers.load(std::memory_order_seq_cst) == 0) {
+      if (!worker.queue.try_dequeue(job)) break;
+      execute(job);
+      continue;
+    }
+    std::this_thread::yield();
+  }
+
+  // Everything above the queue was job scratch, give the pages back
+  worker.localArena.rewind(worker.arenaBase);
+  worker.localArena.trim();
+}
+
+void JobSystem::runAutoScaler() {
+  std::unique_lock lock(_scalerMutex);
+  while (!_scalerWakeup.wait_for(lock, _autoScaler.interval, [this]() { return !_scalerRunning; })) {
+    lock.unlock();
+    autoScale();
+    lock.lock();
+  }
+}
+
+void JobSystem::autoScale() {
+  uint64_t now = clockNow();
+  auto shrinkIdleTime = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(_autoScaler.shrinkIdleTime).count());
+  size_t sharedJobs = queuedSharedJobs();
+
+  for (uint32_t g = 0; g < _groups.size(); ++g) {
+    WorkerGroup& group = *_groups[g];
+    if (group.minCount == group.capacity) continue;
+
+    size_t count = group.count.load(std::memory_order_acquire);
+    size_t queued = group.acceptsSharedJobs ? sharedJobs : 0;
+    for (size_t i = 0; i < count; ++i) {
+      const WorkerThread& worker = *_workers[group.firstWorker + i];
+      queued += std::min(worker.queue.size_approx(), worker.queue.capacity());
+    }
+
+    if (queued > count * _autoScaler.growQueueDepth && count < group.capacity) {
+      resizeGroup(g, count + 1);
+      continue;
+    }
+
+    const WorkerThread& last = *_workers[group.firstWorker + count - 1];
+    uint64_t idleSince = last.idleSince.load(std::memory_order_relaxed);
+    if (count > group.minCount && idleSince != 0 && now > idleSince && now - idleSince >= shrinkIdleTime) {
+      resizeGroup(g, count - 1);
+    }
+  }
+}
+
+uint32_t JobSystem::findGroup(std::string_view name) const {
+  for (uint32_t i = 0; i < _groups.size(); ++i) {
+    if (_groups[i]->name == name) {
+      return i;
+    }
+  }
+  return InvalidGroup;
+}
+
+size_t JobSystem::groupSize(uint32_t group) const {
+  assert(group < _groups.size());
+  return _groups[group]->count.load(std::memory_order_relaxed);
+}
+
+size_t JobSystem::threadCount() const { return _threadCount.load(std::memory_order_relaxed); }
+const NumaTopology& JobSystem::topology() const { return _topology; }
+BlockingPool& JobSystem::blockingPool() { return _blockingPool; }
+IoService& JobSystem::io() { return _io; }
+
 JobGraph JobSystem::createGraph(MemoryClass cls) {
   switch (cls) {
     case MemoryClass::Frame:
@@ -116,9 +817,89 @@ bool JobSystem::isCancelled(const JobHandle& handle) {
 }
 
 bool JobSystem::cancel(JobHandle handle) {
-  // @TODO: Check for JobFlags::Cancelable (add the JobFlags to the control block?)
   if (!handle.isValid()) return false;
-  handle.control->cancelRequested.store(true, std::memory_order_release);
+
+  JobControlBlock* control = handle.control;
+  if (!HasFlag(control->flags.load(std::memory_order_relaxed), JobFlags::Cancelable)) return false;
+
+  JobState state = control->state.load(std::memory_order_acquire);
+  if (state == JobState::Completed || state == JobState::Cancelled) return false;
+
+  control->cancelRequested.store(true, std::memory_order_release);
+  return true;
+}
+
+uint64_t JobSystem::clockNow() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+uint64_t JobSystem::deadlineIn(std::chrono::nanoseconds duration) {
+  return clockNow() + static_cast<uint64_t>(duration.count());
+}
+
+void JobSystem::beginFrame(std::chrono::nanoseconds budget) {
+  _frameStart.store(clockNow(), std::memory_order_relaxed);
+  _frameBudget.store(static_cast<uint64_t>(budget.count()), std::memory_order_relaxed);
+  _missedDeadlines.store(0, std::memory_order_relaxed);
+}
+
+FrameBudgetStatus JobSystem::frameBudget() const {
+  uint64_t now = clockNow();
+  uint64_t start = _frameStart.load(std::memory_order_relaxed);
+  uint64_t budget = _frameBudget.load(std::memory_order_relaxed);
+
+  FrameBudgetStatus status;
+  status.elapsed = std::chrono::nanoseconds(start ? now - start : 0);
+  status.budget = std::chrono::nanoseconds(budget);
+  status.pendingDeadlineJobs = _pendingDeadlineJobs.load(std::memory_order_relaxed);
+  status.missedDeadlines = _missedDeadlines.load(std::memory_order_relaxed);
+
+  for (const auto& node : _nodes) {
+    for (const auto& lane : node->lanes) {
+      uint64_t earliest = lane->deadlines.earliest();
+      if (earliest != 0 && (status.earliestQueuedDeadline == 0 || earliest < status.earliestQueuedDeadline)) {
+        status.earliestQueuedDeadline = earliest;
+      }
+    }
+  }
+
+  bool overThreshold = budget != 0 && static_cast<double>(now - start) >= static_cast<double>(budget) * _frameRiskThreshold;
+  bool queuedPastDeadline = status.earliestQueuedDeadline != 0 && status.earliestQueuedDeadline <= now;
+
+  status.atRisk = status.missedDeadlines > 0 || queuedPastDeadline || (overThreshold && status.pendingDeadlineJobs > 0);
+  return status;
+}
+
+bool JobSystem::isFrameBudgetAtRisk() const {
+  return frameBudget().atRisk;
+}
+
+bool JobSystem::isCancellationRequested() {
+  JobControlBlock* control = t_currentControl;
+  return control && control->cancelRequested.load(std::memory_order_relaxed);
+}
+
+bool JobSystem::runPendingJob() {
+  Job job;
+  WorkerThread* worker = t_currentWorker;
+
+  if (worker && worker->system == this) {
+    if (worker->queue.try_dequeue(job)) {
+      execute(job);
+      return true;
+    }
+    if (!worker->acceptsSharedJobs || !getNextJob(job, worker->node)) {
+      return false;
+    }
+    execute(job);
+    return true;
+  }
+
+  if (!getNextJob(job, 0)) {
+    return false;
+  }
+  execute(job);
   return true;
 }
 
@@ -1,14 +1,30 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <utility>
 #include <vector>
 
 #include "ArenaVector.hpp"
+#include "BlockingPool.hpp"
+#include "ContinuationPool.hpp"
+#include "DeadlineQueue.hpp"
+#include "IoService.hpp"
 #include "Job.hpp"
 #include "LockFreeQueue.hpp"
+#include "NumaTopology.hpp"
 #include "ThreadArenaRegistry.hpp"
 
 class JobGraph;
@@ -18,12 +34,133 @@ enum MemoryClass {
   LongLived
 };
 
+//
+//  A named set of workers. Jobs flagged with JobFlags::WorkerAffinity
+//  are routed to a group (and optionally a specific worker inside of it)
+//  through the worker's own queue.
+//
+//  `cpus` pins the group's threads: by default every worker may run on any
+//  CPU in the set, with `spreadAcrossCpus` worker i is pinned to cpus[i % n].
+//  An empty set leaves the workers unpinned.
+//
+//  Groups with `acceptsSharedJobs = false` only run jobs targeted at them,
+//  which keeps latency sensitive workers from picking up bulk work.
+//
+//  A group starts with `threadCount` workers and can be resized at runtime
+//  (JobSystem::resizeGroup, or the auto-scaler) between `minThreadCount`
+//  and `maxThreadCount`. Both default to 0, meaning threadCount, i.e. a
+//  fixed size group.
+//
+struct WorkerGroupConfig {
+  std::string name = "main";
+  size_t threadCount = 1;
+  size_t minThreadCount = 0;
+  size_t maxThreadCount = 0;
+  std::vector<uint32_t> cpus;
+  bool spreadAcrossCpus = false;
+  bool acceptsSharedJobs = true;
+};
+
+//
+//  Resizes elastic groups from a background thread every `interval`. A
+//  group grows by one worker while more than `growQueueDepth` jobs per
+//  worker are queued for it, and shrinks by one once its last worker has
+//  found no work for `shrinkIdleTime` (so retiring it never waits on a
+//  running job).
+//
+struct WorkerAutoScalerConfig {
+  bool enabled = false;
+  std::chrono::milliseconds interval{10};
+  size_t growQueueDepth = 4;
+  std::chrono::milliseconds shrinkIdleTime{1000};
+};
+
+//
+//  On multi-node machines (`numaAware` and more than one node) every
+//  worker belongs to a NUMA node: pinned workers take the node of their
+//  first CPU, unpinned workers are spread across nodes and pinned to the
+//  node's CPU set. With no groups given, one group per node is created
+//  ("node0", "node1", ...) sized to the node's CPU count. On a single node
+//  a "main" group with one worker per hardware thread is used instead.
+//
+//  Leaving `topology` empty discovers it from sysfs, setting it allows
+//  faking a multi-node layout on a single node machine.
+//
+struct JobSystemConfig {
+  std::vector<WorkerGroupConfig> groups;
+  // Arenas reserve address space and commit it as it's used, see VirtualArenaConfig
+  size_t workerArenaSize = 64 * 1024 * 1024;
+  size_t frameArenaReserve = 256 * 1024 * 1024;
+  size_t longLivedArenaReserve = 256 * 1024 * 1024;
+  bool numaAware = true;
+  std::optional<NumaTopology> topology;
+  BlockingPoolConfig blockingPool;
+  IoServiceConfig io;
+
+  // A priority class not served for this long is picked ahead of higher classes
+  std::chrono::microseconds agingThreshold{4000};
+
+  // Fraction of the frame budget after which outstanding deadline work puts the frame at risk
+  double frameRiskThreshold = 0.8;
+
+  // Workers without work yield for this long, then sleep until a job is submitted
+  std::chrono::microseconds idleSpinTime{200};
+  WorkerAutoScalerConfig autoScaler;
+};
+
+struct FrameBudgetStatus {
+  std::chrono::nanoseconds elapsed{0};
+  std::chrono::nanoseconds budget{0};
+  size_t pendingDeadlineJobs = 0;  // Submitted with a deadline and not finished yet
+  size_t missedDeadlines = 0;      // Finished after their deadline since beginFrame()
+  uint64_t earliestQueuedDeadline = 0;
+  bool atRisk = false;
+};
+
+struct WorkerGroup {
+  std::string name;
+  size_t firstWorker = 0;
+  std::atomic<size_t> count = 0;  // Running workers, always the first `count` of the group
+  size_t minCount = 0;
+  size_t capacity = 0;  // Worker slots reserved for the group
+  bool acceptsSharedJobs = true;
+  std::atomic<uint32_t> nextWorker = 0;
+};
+
+struct PriorityLane {
+  explicit PriorityLane(FrameArena* arena) : fifo(512, arena) {}
+
+  LockFreeQueue<Job> fifo;
+  DeadlineQueue deadlines;
+};
+
+//
+//  Shared queues for one NUMA node, one lane per JobPriority. Workers
+//  drain their own node's lane before stealing the same class from other
+//  nodes, closest first. The queue storage is placed on the node it serves.
+//
+struct NumaNodeContext {
+  explicit NumaNodeContext(int numaNode)
+      : memory(256 * 1024, numaNode), arena(memory.data(), memory.size()) {
+    for (auto& lane : lanes) {
+      lane = std::make_unique<PriorityLane>(&arena);
+    }
+  }
+
+  NumaMemory memory;
+  FrameArena arena;
+  std::array<std::unique_ptr<PriorityLane>, JobPriority::PriorityCount> lanes;
+  std::vector<size_t> stealOrder;  // Node positions, closest first, starting with this node
+};
+
 class JobSystem;
 struct WorkerThread {
-  WorkerThread() : localArena(512 * 1024), queue(256, &localArena) {}
+  WorkerThread() : WorkerThread(512 * 1024) {}
 
-  explicit WorkerThread(size_t arenaSize)
-      : localArena(arenaSize), queue(256, &localArena) {}
+  explicit WorkerThread(size_t arenaSize, int numaNode = NumaMemory::AnyNode)
+      : localArena(VirtualArenaConfig{.reserve = arenaSize, .numaNode = numaNode}),
+        queue(256, &localArena),
+        arenaBase(localArena.mark()) {}
 
   ~WorkerThread() = default;
   WorkerThread(const WorkerThread&) = delete;
@@ -34,10 +171,27 @@ struct WorkerThread {
   std::thread thread;
   FrameArena localArena;
   LockFreeQueue<Job> queue;
+  size_t arenaBase = 0;  // localArena mark past the queue, what a retired worker rewinds to
 
   size_t index = 0;
+  uint32_t group = 0;
+  size_t node = 0;  // Position in the system's NumaTopology
+  std::string name;
+  std::vector<uint32_t> cpus;
+  bool acceptsSharedJobs = true;
   std::atomic<bool> running = true;
 
+  // Cleared when the worker retires, affinity jobs are routed elsewhere from then on
+  std::atomic<bool> accepting = true;
+  // Affinity submitters past the `accepting` check, the retiring worker drains until they're gone
+  std::atomic<uint32_t> enqueuers = 0;
+  std::atomic<uint64_t> idleSince = 0;  // clockNow() when it ran out of work, 0 while busy
+
+  std::atomic<bool> sleeping = false;
+  std::mutex sleepMutex;
+  std::condition_variable wakeup;
+  bool wakeRequested = false;  // Guarded by sleepMutex
+
   JobSystem* system = nullptr;
 
   void run();
@@ -45,11 +199,43 @@ struct WorkerThread {
 
 class JobSystem {
  public:
+  static constexpr uint32_t InvalidGroup = UINT32_MAX;
+
   JobSystem(size_t threadCount);
+  explicit JobSystem(const JobSystemConfig& config);
 
   ~JobSystem();
 
-  void submit(Job& job);
+  // The handle is only valid when the job has a control block
+  JobHandle submit(Job& job);
+  JobHandle submitRead(IoRequest& request);
+  JobHandle submitWrite(IoRequest& request);
+
+  uint32_t findGroup(std::string_view name) const;
+  // Running workers, both change when groups are resized
+  size_t groupSize(uint32_t group) const;
+  size_t threadCount() const;
+
+  //
+  //  Starts or retires workers until `group` has `count` of them, clamped
+  //  to the group's min/max thread count, and returns the new size. Safe
+  //  to call while jobs run, but not from a worker it would retire.
+  //
+  //  The highest numbered workers retire first: they stop taking affinity
+  //  jobs, finish what's in their own queue, hand back the memory their
+  //  arena committed and exit. A retired slot is reused (arena and queue
+  //  included) when the group grows again.
+  //
+  //  Affinity jobs that name a specific worker must target a running one,
+  //  naming a retired index asserts (and cancels the job in release
+  //  builds). Workers below the group's minThreadCount are never retired,
+  //  keep thread bound state on those.
+  //
+  size_t resizeGroup(uint32_t group, size_t count);
+
+  const NumaTopology& topology() const;
+  BlockingPool& blockingPool();
+  IoService& io();
 
   JobGraph createGraph(MemoryClass cls = MemoryClass::Frame);
   void submitGraph(JobGraph& graph);
@@ -59,21 +245,131 @@ class JobSystem {
   bool cancel(JobHandle handle);
   void wait(JobHandle handle);
 
+  //
+  //  Continuations: `next` is submitted once `antecedent` finished
+  //  (completed or cancelled), without building a graph:
+  //
+  //      system.submit(load).then(parse).then(upload);
+  //      system.then(system.whenAll(a, b, c), merge);
+  //
+  //  The finishing thread dispatches them. On a worker the first one goes
+  //  to that worker's own queue so it runs next with the antecedent's data
+  //  still in cache; the rest (and continuations with a deadline, affinity
+  //  or LongRunning) are submitted as usual. Attaching to a job that
+  //  already finished submits `next` right away.
+  //
+  //  `antecedent` needs a control block and must have been submitted (or
+  //  belong to a submitted graph) before continuations are attached. A
+  //  `next` without a control block gets one from frameArena(), as do the
+  //  handles returned by whenAll/whenAny, so those stay valid until that
+  //  arena is reset.
+  //
+  JobHandle then(JobHandle antecedent, Job& next);
+
+  // Finishes once every handle finished, invalid handles count as finished
+  JobHandle whenAll(std::span<const JobHandle> handles);
+  // Finishes once the first handle finished, must outlive all of them
+  JobHandle whenAny(std::span<const JobHandle> handles);
+
+  template <typename... Handles>
+    requires(std::same_as<Handles, JobHandle> && ...)
+  JobHandle whenAll(const Handles&... handles) {
+    const std::array<JobHandle, sizeof...(Handles)> list{handles...};
+    return whenAll(std::span<const JobHandle>(list));
+  }
+
+  template <typename... Handles>
+    requires(std::same_as<Handles, JobHandle> && ...)
+  JobHandle whenAny(const Handles&... handles) {
+    const std::array<JobHandle, sizeof...(Handles)> list{handles...};
+    return whenAny(std::span<const JobHandle>(list));
+  }
+
+  // Publishes the final state of a control block completed outside of
+  // execute() (I/O, graph nodes) and dispatches its continuations
+  void finish(JobControlBlock& control, JobState state);
+
+  // Cheap poll for long running job bodies, false outside of a job
+  static bool isCancellationRequested();
+
+  static uint64_t clockNow();
+  static uint64_t deadlineIn(std::chrono::nanoseconds duration);
+
+  void beginFrame(std::chrono::nanoseconds budget);
+  FrameBudgetStatus frameBudget() const;
+  bool isFrameBudgetAtRisk() const;
+
+  // FrameArenaMode::Concurrent, jobs may allocate from them in parallel
   FrameArena& frameArena();
   FrameArena& longLivedArena();
 
-  bool getNextJob(Job& out);
+  bool getNextJob(Job& out, size_t node = 0);
+  void execute(Job& job);
+
+  //
+  //  Runs one queued job on the calling thread, the way a worker would:
+  //  a worker of this system checks its own queue first, other threads
+  //  only take shared jobs. Returns false when nothing was runnable. Lets
+  //  code that waits on other jobs help instead of spinning.
+  //
+  bool runPendingJob();
 
  private:
+  friend struct WorkerThread;
+
+  void enqueueOnWorker(Job& job);
+  void startWorker(size_t index);
+  void retireWorker(size_t index);
+  void drainWorker(WorkerThread& worker);
+  bool hasQueuedWork(const WorkerThread& worker) const;
+  size_t queuedSharedJobs() const;
+  void sleepUntilWork(WorkerThread& worker);
+  void wakeWorker(WorkerThread& worker);
+  void wakeSharedWorker();
+  void runAutoScaler();
+  void autoScale();
+  JobControlBlock* newControlBlock();
+  uint32_t newContinuation(const Job& job, bool runInline);
+  void attach(JobControlBlock& control, uint32_t continuation);
+  void dispatchContinuations(uint32_t head);
+  bool dequeueClass(JobPriority priority, size_t node, Job& out);
+  void markServed(JobPriority priority, uint64_t now);
+  WorkerThread* resolveAffinity(const Job& job);
+
   FrameArena _frameArena;
   FrameArena _longLivedArena;
   FrameArena _internalArena;
 
-  size_t _threadCount;
+  std::atomic<size_t> _threadCount;
+  NumaTopology _topology;
+  std::vector<std::unique_ptr<NumaNodeContext>> _nodes;
+  std::atomic<uint32_t> _nextNode = 0;
 
   // @TODO: Use a PMR vector and custom allocator for the WorkerThreads to avoid all of this
   std::vector<std::unique_ptr<WorkerThread>> _workers;
+  std::vector<std::unique_ptr<WorkerGroup>> _groups;
+  std::mutex _resizeMutex;
+
+  uint64_t _idleSpinTime = 0;
+  std::atomic<size_t> _sleepingSharedWorkers = 0;
+
+  WorkerAutoScalerConfig _autoScaler;
+  std::thread _scalerThread;
+  std::mutex _scalerMutex;
+  std::condition_variable _scalerWakeup;
+  bool _scalerRunning = false;  // Guarded by _scalerMutex
+
+  uint64_t _agingThreshold = 0;
+  std::array<std::atomic<uint64_t>, JobPriority::PriorityCount> _lastServed{};
+
+  double _frameRiskThreshold = 0.8;
+  std::atomic<uint64_t> _frameStart = 0;
+  std::atomic<uint64_t> _frameBudget = 0;
+  std::atomic<size_t> _pendingDeadlineJobs = 0;
+  std::atomic<size_t> _missedDeadlines = 0;
+
+  ContinuationPool _continuations;
 
-  LockFreeQueue<Job> _globalQueue;
-  LockFreeQueue<Job> _highPriorityQueue;
+  BlockingPool _blockingPool;
+  IoService _io;
 };
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "NumaTopology.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "ThreadAffinity.hpp"
+
+// From <numaif.h>, spelled out so we don't need to link libnuma
+static constexpr int MPOL_PREFERRED_MODE = 1;
+
+static bool readFile(const std::filesystem::path& path, std::string& out) {
+  std::ifstream file(path);
+  if (!file) return false;
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  out = buffer.str();
+  return true;
+}
+
+static bool parseNumber(std::string_view text, uint32_t& out) {
+  auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+  return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+static std::string_view trim(std::string_view text) {
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) text.remove_prefix(1);
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) text.remove_suffix(1);
+  return text;
+}
+
+bool NumaTopology::parseCpuList(std::string_view text, std::vector<uint32_t>& out) {
+  text = trim(text);
+  while (!text.empty()) {
+    size_t comma = text.find(',');
+    std::string_view range = trim(text.substr(0, comma));
+    text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+
+    if (range.empty()) continue;
+
+    size_t dash = range.find('-');
+    uint32_t first = 0;
+    uint32_t last = 0;
+    if (dash == std::string_view::npos) {
+      if (!parseNumber(range, first)) return false;
+      last = first;
+    } else {
+      if (!parseNumber(range.substr(0, dash), first)) return false;
+      if (!parseNumber(range.substr(dash + 1), last)) return false;
+      if (last < first) return false;
+    }
+
+    for (uint32_t cpu = first; cpu <= last; ++cpu) {
+      out.push_back(cpu);
+    }
+  }
+  return true;
+}
+
+NumaTopology NumaTopology::discover(const std::string& sysfsRoot) {
+  namespace fs = std::filesystem;
+
+  NumaTopology topology;
+  std::error_code ec;
+  if (!fs::is_directory(sysfsRoot, ec)) {
+    return singleNode(ThreadAffinity::hardwareThreadCount());
+  }
+
+  for (const auto& entry : fs::directory_iterator(sysfsRoot, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind("node", 0) != 0) continue;
+
+    NumaNode node;
+    if (!parseNumber(std::string_view(name).substr(4), node.id)) continue;
+
+    std::string cpulist;
+    if (!readFile(entry.path() / "cpulist", cpulist)) continue;
+    if (!parseCpuList(cpulist, node.cpus)) continue;
+
+    // Memory-only nodes (CXL, HBM) have no CPUs to run workers on
+    if (node.cpus.empty()) continue;
+
+    std::string distances;
+    if (readFile(entry.path() / "distance", distances)) {
+      std::istringstream stream(distances);
+      uint32_t distance = 0;
+      while (stream >> distance) {
+        node.distances.push_back(distance);
+      }
+    }
+
+    topology._nodes.push_back(std::move(node));
+  }
+
+  if (topology._nodes.empty()) {
+    return singleNode(ThreadAffinity::hardwareThreadCount());
+  }
+
+  std::sort(topology._nodes.begin(), topology._nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+
+  // sysfs distances are indexed by node id, remap them to positions since
+  // memory-only nodes were skipped above
+  for (auto& node : topology._nodes) {
+    std::vector<uint32_t> remapped;
+    remapped.reserve(topology._nodes.size());
+    for (const auto& other : topology._nodes) {
+      bool known = other.id < node.distances.size();
+      remapped.push_back(known ? node.distances[other.id] : (other.id == node.id ? 10u : 20u));
+    }
+    node.distances = std::move(remapped);
+  }
+
+  return topology;
+}
+
+NumaTopology NumaTopology::singleNode(uint32_t cpuCount) {
+  NumaTopology topology;
+  NumaNode node;
+  for (uint32_t cpu = 0; cpu < cpuCount; ++cpu) {
+    node.cpus.push_back(cpu);
+  }
+  node.distances.push_back(10);
+  topology._nodes.push_back(std::move(node));
+  return topology;
+}
+
+NumaTopology NumaTopology::fake(size_t nodeCount, size_t cpusPerNode) {
+  assert(nodeCount > 0 && cpusPerNode > 0);
+
+  NumaTopology topology;
+  topology._simulated = true;
+  for (size_t n = 0; n < nodeCount; ++n) {
+    NumaNode node;
+    node.id = static_cast<uint32_t>(n);
+    for (size_t c = 0; c < cpusPerNode; ++c) {
+      node.cpus.push_back(static_cast<uint32_t>(n * cpusPerNode + c));
+    }
+    for (size_t other = 0; other < nodeCount; ++other) {
+      node.distances.push_back(other == n ? 10 : 20);
+    }
+    topology._nodes.push_back(std::move(node));
+  }
+  return topology;
+}
+
+size_t NumaTopology::nodeCount() const { return _nodes.size(); }
+
+const NumaNode& NumaTopology::node(size_t index) const {
+  assert(index < _nodes.size());
+  return _nodes[index];
+}
+
+const std::vector<NumaNode>& NumaTopology::nodes() const { return _nodes; }
+
+size_t NumaTopology::nodeOfCpu(uint32_t cpu) const {
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    const auto& cpus = _nodes[i].cpus;
+    if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+std::vector<size_t> NumaTopology::nodesByDistance(size_t from) const {
+  assert(from < _nodes.size());
+
+  std::vector<size_t> order(_nodes.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+
+  const auto& distances = _nodes[from].distances;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (a == from || b == from) return a == from && b != from;
+    uint32_t da = a < distances.size() ? distances[a] : UINT32_MAX;
+    uint32_t db = b < distances.size() ? distances[b] : UINT32_MAX;
+    return da < db;
+  });
+  return order;
+}
+
+bool NumaTopology::isSimulated() const { return _simulated; }
+
+NumaMemory::NumaMemory(size_t size, int node) : _size(size) {
+  assert(size > 0);
+
+  void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  assert(mapping != MAP_FAILED && "NumaMemory failed to map memory");
+  _data = static_cast<std::byte*>(mapping);
+
+  _bound = bind(_data, _size, node);
+}
+
+bool NumaMemory::bind(void* data, size_t size, int node) {
+  if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8)) {
+    return false;
+  }
+  unsigned long mask = 1ul << node;
+  return syscall(SYS_mbind, data, size, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8, 0) == 0;
+}
+
+NumaMemory::~NumaMemory() {
+  if (_data) {
+    munmap(_data, _size);
+  }
+}
+
+NumaMemory::NumaMemory(NumaMemory&& other) noexcept
+    : _data(other._data), _size(other._size), _bound(other._bound) {
+  other._data = nullptr;
+  other._size = 0;
+  other._bound = false;
+}
+
+NumaMemory& NumaMemory::operator=(NumaMemory&& other) noexcept {
+  if (&other == this) {
+    return *this;
+  }
+  if (_data) {
+    munmap(_data, _size);
+  }
+  _data = other._data;
+  _size = other._size;
+  _bound = other._bound;
+  other._data = nullptr;
+  other._size = 0;
+  other._bound = false;
+  return *this;
+}
+
+void NumaMemory::prefault(size_t from) {
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  for (size_t offset = (from + page - 1) / page * page; offset < _size; offset += page) {
+    // Reading would map the shared zero page, only a write allocates
+    reinterpret_cast<volatile std::byte*>(_data)[offset] = reinterpret_cast<volatile std::byte*>(_data)[offset];
+  }
+}
+
+std::byte* NumaMemory::data() const { return _data; }
+size_t NumaMemory::size() const { return _size; }
+bool NumaMemory::isBound() const { return _bound; }
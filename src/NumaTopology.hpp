@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//
+//  NUMA layout of the machine, read from sysfs:
+//
+//      /sys/devices/system/node/nodeN/cpulist     "0-7,16-23"
+//      /sys/devices/system/node/nodeN/distance    "10 21"
+//
+//  Machines without that directory (or non-Linux boxes) are reported as a
+//  single node holding every hardware thread.
+//
+//  A topology can also be faked (or discovered from a copy of the sysfs
+//  tree) so the multi-node code paths run on a single node machine.
+//  Simulated topologies never bind memory since the nodes don't exist.
+//
+struct NumaNode {
+  uint32_t id = 0;
+  std::vector<uint32_t> cpus;
+  std::vector<uint32_t> distances;  // Indexed by position in NumaTopology::nodes()
+};
+
+class NumaTopology {
+ public:
+  static NumaTopology discover(const std::string& sysfsRoot = "/sys/devices/system/node");
+  static NumaTopology singleNode(uint32_t cpuCount);
+  static NumaTopology fake(size_t nodeCount, size_t cpusPerNode);
+
+  static bool parseCpuList(std::string_view text, std::vector<uint32_t>& out);
+
+  size_t nodeCount() const;
+  const NumaNode& node(size_t index) const;
+  const std::vector<NumaNode>& nodes() const;
+
+  // Position of the node owning `cpu`, 0 when the cpu is unknown
+  size_t nodeOfCpu(uint32_t cpu) const;
+
+  // Every node ordered from closest to furthest, starting with `from` itself
+  std::vector<size_t> nodesByDistance(size_t from) const;
+
+  bool isSimulated() const;
+
+ private:
+  std::vector<NumaNode> _nodes;
+  bool _simulated = false;
+};
+
+//
+//  Anonymous mapping whose pages prefer a given node. The preference is
+//  applied with mbind(MPOL_PREFERRED) before any page is touched, so the
+//  placement holds no matter which thread faults the memory in. When the
+//  kernel refuses (no NUMA support, simulated node) placement falls back
+//  to first-touch, which is why workers prefault their own memory after
+//  pinning themselves.
+//
+class NumaMemory {
+ public:
+  static constexpr int AnyNode = -1;
+
+  NumaMemory() = default;
+  NumaMemory(size_t size, int node);
+  ~NumaMemory();
+
+  NumaMemory(const NumaMemory&) = delete;
+  NumaMemory& operator=(const NumaMemory&) = delete;
+  NumaMemory(NumaMemory&& other) noexcept;
+  NumaMemory& operator=(NumaMemory&& other) noexcept;
+
+  // Writes every page from offset `from` on so it's faulted in by (and, under first-touch,
+  // placed near) the calling thread. Memory already shared with other threads must lie below `from`.
+  void prefault(size_t from = 0);
+
+  // Applies the node preference to any mapping, false when the kernel refused
+  static bool bind(void* data, size_t size, int node);
+
+  std::byte* data() const;
+  size_t size() const;
+  bool isBound() const;
+
+ private:
+  std::byte* _data = nullptr;
+  size_t _size = 0;
+  bool _bound = false;
+};
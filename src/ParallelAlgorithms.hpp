@@ -0,0 +1,521 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "FrameArena.hpp"
+#include "JobSystem.hpp"
+#include "ThreadArenaRegistry.hpp"
+
+//
+//  Parallel algorithms on JobSystem workers, mirroring the std execution
+//  policy overloads:
+//
+//      parallel::sort(parallel::par(system), values.begin(), values.end());
+//      parallel::inclusive_scan(parallel::par(system), in.begin(), in.end(), out.begin());
+//
+//  The range is split into chunks that are claimed dynamically by up to
+//  threadCount() helper jobs and by the calling thread, which keeps
+//  running queued jobs (JobSystem::runPendingJob) until its helpers are
+//  done, so calling these from inside a job is fine.
+//
+//  Scratch memory (per-chunk partials, histograms, merge buffers) comes
+//  from the calling worker's localArena and is rewound on return; callers
+//  that aren't workers, or buffers that don't fit, fall back to the heap.
+//  Element types that go through scratch must be trivially copyable.
+//
+namespace parallel {
+
+struct JobPolicy {
+  JobSystem* system = nullptr;  // nullptr runs everything on the calling thread
+  size_t grainSize = 0;         // Minimum elements per chunk, 0 picks a default per algorithm
+  JobPriority priority = JobPriority::High;
+};
+
+inline JobPolicy par(JobSystem& system, size_t grainSize = 0) { return {&system, grainSize}; }
+inline constexpr JobPolicy seq{};
+
+namespace detail {
+
+inline size_t chunkCount(const JobPolicy& policy, size_t n, size_t defaultGrain) {
+  if (!policy.system || n == 0) return 1;
+  size_t grain = policy.grainSize ? policy.grainSize : defaultGrain;
+  size_t maxChunks = (policy.system->threadCount() + 1) * 4;
+  return std::clamp<size_t>((n + grain - 1) / grain, 1, maxChunks);
+}
+
+// Elements [first, second) of chunk i, chunks never come out empty while chunks <= n
+inline std::pair<size_t, size_t> chunkRange(size_t n, size_t chunks, size_t i) {
+  return {n * i / chunks, n * (i + 1) / chunks};
+}
+
+//
+//  Calls fn(i) for every i in [0, chunks) across the workers and the
+//  calling thread, returns once all of them ran.
+//
+template <typename Fn>
+void forEachChunk(const JobPolicy& policy, size_t chunks, Fn&& fn) {
+  if (!policy.system || chunks <= 1) {
+    for (size_t i = 0; i < chunks; ++i) fn(i);
+    return;
+  }
+
+  struct Context {
+    std::remove_reference_t<Fn>* fn;
+    size_t count;
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> finished = 0;
+
+    void drain() {
+      for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count; i = next.fetch_add(1, std::memory_order_relaxed)) {
+        (*fn)(i);
+      }
+    }
+  };
+
+  Context context{&fn, chunks};
+  size_t helpers = std::min(chunks - 1, policy.system->threadCount());
+
+  for (size_t i = 0; i < helpers; ++i) {
+    Job job;
+    job.fn = [](void* userData) {
+      auto* context = static_cast<Context*>(userData);
+      context->drain();
+      context->finished.fetch_add(1, std::memory_order_release);
+    };
+    job.userData = &context;
+    job.priority = policy.priority;
+    policy.system->submit(job);
+  }
+
+  context.drain();
+
+  // The context lives on this stack, every helper must be done with it
+  while (context.finished.load(std::memory_order_acquire) < helpers) {
+    if (!policy.system->runPendingJob()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+//
+//  Uninitialized scratch for trivially copyable T. Taken from the calling
+//  thread's arena when it has a single threaded one with enough room, from
+//  the heap otherwise. Jobs the caller runs while it waits (runPendingJob)
+//  may allocate from the same arena above the scratch, so it's only given
+//  back when it's still on top; otherwise it stays until the arena resets.
+//
+template <typename T>
+class ScratchBuffer {
+ public:
+  static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+                "Parallel algorithm scratch needs trivially copyable types");
+
+  explicit ScratchBuffer(size_t count) {
+    FrameArena* arena = ThreadArenaRegistry::get();
+    if (arena && arena->mode() == FrameArenaMode::SingleThreaded) {
+      size_t mark = arena->mark();
+      _data = static_cast<T*>(arena->allocateRaw(std::max<size_t>(sizeof(T) * count, 1), std::max<size_t>(alignof(T), 64)));
+      if (_data) {
+        _arena = arena;
+        _mark = mark;
+        _end = arena->mark();
+        return;
+      }
+    }
+    _heap.reset(new T[count]);
+    _data = _heap.get();
+  }
+
+  ~ScratchBuffer() {
+    if (_arena && _arena->mark() == _end) _arena->rewind(_mark);
+  }
+
+  ScratchBuffer(const ScratchBuffer&) = delete;
+  ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+  T& operator[](size_t i) { return _data[i]; }
+  T* data() { return _data; }
+
+ private:
+  T* _data = nullptr;
+  FrameArena* _arena = nullptr;
+  size_t _mark = 0;
+  size_t _end = 0;  // Arena top right after the allocation
+  std::unique_ptr<T[]> _heap;
+};
+
+template <typename T>
+void copy(const JobPolicy& policy, const T* src, size_t n, T* dst) {
+  size_t chunks = chunkCount(policy, n, 256 * 1024);
+  forEachChunk(policy, chunks, [&](size_t c) {
+    auto [begin, end] = chunkRange(n, chunks, c);
+    std::copy(src + begin, src + end, dst + begin);
+  });
+}
+
+template <bool Inclusive, typename InputIt, typename OutputIt, typename T, typename BinaryOp>
+OutputIt scan(const JobPolicy& policy, InputIt first, InputIt last, OutputIt out, T init, BinaryOp op) {
+  size_t n = static_cast<size_t>(std::distance(first, last));
+  if (n == 0) return out;
+
+  size_t chunks = chunkCount(policy, n, 64 * 1024);
+  ScratchBuffer<T> carry(chunks);
+
+  // Pass 1: reduce every chunk but the last, whose total nobody needs
+  forEachChunk(policy, chunks - 1, [&](size_t c) {
+    auto [begin, end] = chunkRange(n, chunks, c);
+    T sum = first[begin];
+    for (size_t i = begin + 1; i < end; ++i) sum = op(sum, first[i]);
+    carry[c] = sum;
+  });
+
+  // Turn the totals into what flows into each chunk. Inclusive scans have
+  // nothing flowing into chunk 0 and don't read carry[0].
+  T running = init;
+  for (size_t c = 0; c + 1 < chunks; ++c) {
+    T sum = carry[c];
+    carry[c] = running;
+    running = (Inclusive && c == 0) ? sum : op(running, sum);
+  }
+  carry[chunks - 1] = running;
+
+  // Pass 2: scan every chunk from its carry, in place safe
+  forEachChunk(policy, chunks, [&](size_t c) {
+    auto [begin, end] = chunkRange(n, chunks, c);
+    if constexpr (Inclusive) {
+      T acc = c == 0 ? T(first[begin]) : op(carry[c], first[begin]);
+      out[begin] = acc;
+      for (size_t i = begin + 1; i < end; ++i) {
+        acc = op(acc, first[i]);
+        out[i] = acc;
+      }
+    } else {
+      T acc = carry[c];
+      for (size_t i = begin; i < end; ++i) {
+        T value = first[i];
+        out[i] = acc;
+        acc = op(acc, value);
+      }
+    }
+  });
+
+  return out + n;
+}
+
+//
+//  Number of elements of `a` among the first k outputs of a stable merge
+//  of a and b (ties take from a first, like std::merge).
+//
+template <typename T, typename Compare>
+size_t coRank(size_t k, const T* a, size_t m, const T* b, size_t n, Compare& comp) {
+  size_t lo = k > n ? k - n : 0;
+  size_t hi = std::min(k, m);
+  while (lo < hi) {
+    size_t i = lo + (hi - lo) / 2;
+    size_t j = k - i;
+    // a[i] is still part of the first k outputs if it goes before b[j - 1]
+    if (j > 0 && i < m && !comp(b[j - 1], a[i])) {
+      lo = i + 1;
+    } else {
+      hi = i;
+    }
+  }
+  return lo;
+}
+
+template <bool Stable, typename T, typename Compare>
+void mergeSort(const JobPolicy& policy, T* data, size_t n, Compare& comp) {
+  size_t grain = policy.grainSize ? policy.grainSize : 32 * 1024;
+  size_t chunks = chunkCount(policy, n, grain);
+  if (chunks == 1) {
+    if constexpr (Stable) {
+      std::stable_sort(data, data + n, comp);
+    } else {
+      std::sort(data, data + n, comp);
+    }
+    return;
+  }
+
+  // Sorted runs, boundaries[r] .. boundaries[r + 1]
+  ScratchBuffer<size_t> boundaries(chunks + 1);
+  for (size_t c = 0; c <= chunks; ++c) {
+    boundaries[c] = n * c / chunks;
+  }
+
+  forEachChunk(policy, chunks, [&](size_t c) {
+    if constexpr (Stable) {
+      std::stable_sort(data + boundaries[c], data + boundaries[c + 1], comp);
+    } else {
+      std::sort(data + boundaries[c], data + boundaries[c + 1], comp);
+    }
+  });
+
+  struct MergeTask {
+    size_t aBegin, aEnd, bBegin, bEnd, out;
+  };
+
+  // Large merges are cut into independent pieces along the merge path so
+  // the last rounds, with only a few pairs left, still use every worker
+  size_t target = (policy.system->threadCount() + 1) * 2;
+  ScratchBuffer<MergeTask> tasks(chunks + target + 1);
+  ScratchBuffer<T> buffer(n);
+
+  T* src = data;
+  T* dst = buffer.data();
+  size_t runCount = chunks;
+
+  while (runCount > 1) {
+    size_t pairs = runCount / 2;
+    size_t partsPerPair = std::max<size_t>(1, target / pairs);
+    size_t taskCount = 0;
+
+    for (size_t p = 0; p < pairs; ++p) {
+      size_t aBegin = boundaries[2 * p];
+      size_t bBegin = boundaries[2 * p + 1];
+      size_t bEnd = boundaries[2 * p + 2];
+      size_t m = bBegin - aBegin;
+      size_t length = bEnd - aBegin;
+      size_t parts = std::clamp<size_t>(length / grain, 1, partsPerPair);
+
+      size_t i0 = 0;
+      for (size_t part = 0; part < parts; ++part) {
+        size_t k0 = length * part / parts;
+        size_t k1 = length * (part + 1) / parts;
+        size_t i1 = part + 1 == parts ? m : coRank(k1, src + aBegin, m, src + bBegin, bEnd - bBegin, comp);
+        tasks[taskCount++] = {aBegin + i0, aBegin + i1, bBegin + (k0 - i0), bBegin + (k1 - i1), aBegin + k0};
+        i0 = i1;
+      }
+    }
+
+    // An odd run out is carried over as is
+    if (runCount % 2 == 1) {
+      size_t begin = boundaries[runCount - 1];
+      tasks[taskCount++] = {begin, n, n, n, begin};
+    }
+
+    forEachChunk(policy, taskCount, [&](size_t t) {
+      const MergeTask& task = tasks[t];
+      std::merge(src + task.aBegin, src + task.aEnd, src + task.bBegin, src + task.bEnd, dst + task.out, comp);
+    });
+
+    size_t merged = (runCount + 1) / 2;
+    for (size_t r = 0; r < merged; ++r) {
+      boundaries[r] = boundaries[2 * r];
+    }
+    boundaries[merged] = n;
+    runCount = merged;
+    std::swap(src, dst);
+  }
+
+  if (src != data) {
+    copy(policy, src, n, data);
+  }
+}
+
+}  // namespace detail
+
+//
+//  Chunks are sorted in parallel, then merged pairwise in log2(chunks)
+//  rounds. Needs a scratch buffer the size of the input.
+//
+template <std::contiguous_iterator It, typename Compare = std::less<>>
+void sort(const JobPolicy& policy, It first, It last, Compare comp = {}) {
+  detail::mergeSort<false>(policy, std::to_address(first), static_cast<size_t>(last - first), comp);
+}
+
+template <std::contiguous_iterator It, typename Compare = std::less<>>
+void stable_sort(const JobPolicy& policy, It first, It last, Compare comp = {}) {
+  detail::mergeSort<true>(policy, std::to_address(first), static_cast<size_t>(last - first), comp);
+}
+
+//
+//  Stable LSD radix sort on integer keys, one byte per pass. Each pass
+//  builds per-chunk histograms in parallel and scatters every chunk to
+//  its own offsets; passes where all keys share the digit are skipped.
+//
+template <std::contiguous_iterator It>
+  requires std::is_integral_v<std::iter_value_t<It>> && (!std::is_same_v<std::iter_value_t<It>, bool>)
+void radix_sort(const JobPolicy& policy, It first, It last) {
+  using T = std::iter_value_t<It>;
+  using U = std::make_unsigned_t<T>;
+
+  // Flipping the sign bit orders signed keys correctly as unsigned
+  constexpr U flip = std::is_signed_v<T> ? U(U(1) << (sizeof(T) * 8 - 1)) : U(0);
+  constexpr size_t Radix = 256;
+
+  size_t n = static_cast<size_t>(last - first);
+  if (n < 2) return;
+
+  T* data = std::to_address(first);
+  size_t chunks = detail::chunkCount(policy, n, 64 * 1024);
+  detail::ScratchBuffer<size_t> offsets(chunks * Radix);
+  detail::ScratchBuffer<T> buffer(n);
+
+  T* src = data;
+  T* dst = buffer.data();
+
+  for (size_t shift = 0; shift < sizeof(T) * 8; shift += 8) {
+    auto digit = [shift](T value) { return static_cast<size_t>((static_cast<U>(value) ^ flip) >> shift) & (Radix - 1); };
+
+    detail::forEachChunk(policy, chunks, [&](size_t c) {
+      auto [begin, end] = detail::chunkRange(n, chunks, c);
+      size_t* counts = &offsets[c * Radix];
+      std::fill(counts, counts + Radix, size_t(0));
+      for (size_t i = begin; i < end; ++i) ++counts[digit(src[i])];
+    });
+
+    // Digit-major, chunk-minor prefix sum keeps equal digits in input order
+    bool allSameDigit = false;
+    size_t running = 0;
+    for (size_t d = 0; d < Radix; ++d) {
+      size_t digitStart = running;
+      for (size_t c = 0; c < chunks; ++c) {
+        size_t count = offsets[c * Radix + d];
+        offsets[c * Radix + d] = running;
+        running += count;
+      }
+      allSameDigit |= running - digitStart == n;
+    }
+    if (allSameDigit) continue;
+
+    detail::forEachChunk(policy, chunks, [&](size_t c) {
+      auto [begin, end] = detail::chunkRange(n, chunks, c);
+      size_t* next = &offsets[c * Radix];
+      for (size_t i = begin; i < end; ++i) {
+        dst[next[digit(src[i])]++] = src[i];
+      }
+    });
+    std::swap(src, dst);
+  }
+
+  if (src != data) {
+    detail::copy(policy, src, n, data);
+  }
+}
+
+template <typename InputIt, typename OutputIt, typename BinaryOp = std::plus<>>
+OutputIt inclusive_scan(const JobPolicy& policy, InputIt first, InputIt last, OutputIt out, BinaryOp op = {}) {
+  using T = std::iter_value_t<InputIt>;
+  return detail::scan<true>(policy, first, last, out, T{}, op);
+}
+
+template <typename InputIt, typename OutputIt, typename T, typename BinaryOp = std::plus<>>
+OutputIt exclusive_scan(const JobPolicy& policy, InputIt first, InputIt last, OutputIt out, T init, BinaryOp op = {}) {
+  return detail::scan<false>(policy, first, last, out, init, op);
+}
+
+//
+//  Counts the matches of every chunk, then scatters matches and
+//  non-matches to their final positions through a scratch buffer.
+//  `pred` is evaluated twice per element and must be pure.
+//
+template <std::contiguous_iterator It, typename Pred>
+It stable_partition(const JobPolicy& policy, It first, It last, Pred pred) {
+  using T = std::iter_value_t<It>;
+
+  size_t n = static_cast<size_t>(last - first);
+  size_t chunks = detail::chunkCount(policy, n, 32 * 1024);
+  if (chunks == 1) {
+    return std::stable_partition(first, last, pred);
+  }
+
+  T* data = std::to_address(first);
+  detail::ScratchBuffer<size_t> matches(chunks);
+
+  detail::forEachChunk(policy, chunks, [&](size_t c) {
+    auto [begin, end] = detail::chunkRange(n, chunks, c);
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) count += pred(data[i]) ? 1 : 0;
+    matches[c] = count;
+  });
+
+  size_t totalMatches = 0;
+  for (size_t c = 0; c < chunks; ++c) {
+    size_t count = matches[c];
+    matches[c] = totalMatches;
+    totalMatches += count;
+  }
+
+  detail::ScratchBuffer<T> buffer(n);
+  detail::forEachChunk(policy, chunks, [&](size_t c) {
+    auto [begin, end] = detail::chunkRange(n, chunks, c);
+    size_t matched = matches[c];
+    size_t rejected = totalMatches + (begin - matches[c]);
+    for (size_t i = begin; i < end; ++i) {
+      if (pred(data[i])) {
+        buffer[matched++] = data[i];
+      } else {
+        buffer[rejected++] = data[i];
+      }
+    }
+  });
+
+  detail::copy(policy, buffer.data(), n, data);
+  return first + static_cast<std::iter_difference_t<It>>(totalMatches);
+}
+
+template <typename RandomIt, typename T, typename Reduce, typename Transform>
+T transform_reduce(const JobPolicy& policy, RandomIt first, RandomIt last, T init, Reduce reduce, Transform transform) {
+  size_t n = static_cast<size_t>(std::distance(first, last));
+  if (n == 0) return init;
+
+  size_t chunks = detail::chunkCount(policy, n, 16 * 1024);
+  detail::ScratchBuffer<T> partials(chunks);
+
+  detail::forEachChunk(policy, chunks, [&](size_t c) {
+    auto [begin, end] = detail::chunkRange(n, chunks, c);
+    T sum = transform(first[begin]);
+    for (size_t i = begin + 1; i < end; ++i) sum = reduce(sum, transform(first[i]));
+    partials[c] = sum;
+  });
+
+  for (size_t c = 0; c < chunks; ++c) {
+    init = reduce(init, partials[c]);
+  }
+  return init;
+}
+
+// Binary form, reduce(transform(first1[i], first2[i]), ...), like std::transform_reduce
+template <typename RandomIt1, typename RandomIt2, typename T, typename Reduce, typename Transform>
+T transform_reduce(const JobPolicy& policy, RandomIt1 first1, RandomIt1 last1, RandomIt2 first2, T init, Reduce reduce, Transform transform) {
+  size_t n = static_cast<size_t>(std::distance(first1, last1));
+  if (n == 0) return init;
+
+  size_t chunks = detail::chunkCount(policy, n, 16 * 1024);
+  detail::ScratchBuffer<T> partials(chunks);
+
+  detail::forEachChunk(policy, chunks, [&](size_t c) {
+    auto [begin, end] = detail::chunkRange(n, chunks, c);
+    T sum = transform(first1[begin], first2[begin]);
+    for (size_t i = begin + 1; i < end; ++i) sum = reduce(sum, transform(first1[i], first2[i]));
+    partials[c] = sum;
+  });
+
+  for (size_t c = 0; c < chunks; ++c) {
+    init = reduce(init, partials[c]);
+  }
+  return init;
+}
+
+// Inner product
+template <typename RandomIt1, typename RandomIt2, typename T>
+T transform_reduce(const JobPolicy& policy, RandomIt1 first1, RandomIt1 last1, RandomIt2 first2, T init) {
+  return transform_reduce(policy, first1, last1, first2, init, std::plus<>{}, std::multiplies<>{});
+}
+
+template <typename RandomIt, typename T, typename BinaryOp = std::plus<>>
+T reduce(const JobPolicy& policy, RandomIt first, RandomIt last, T init, BinaryOp op = {}) {
+  return transform_reduce(policy, first, last, init, op, [](const auto& value) { return T(value); });
+}
+
+}  // namespace parallel
@@ -0,0 +1,253 @@
+#include "Pipeline.hpp"
+
+#include <cassert>
+#include <thread>
+
+#include "JobSystem.hpp"
+
+Pipeline::Pipeline(JobSystem& system, const PipelineConfig& config) : _system(system), _config(config) {
+  assert(_config.maxTokens > 0 && "Pipeline needs at least one token");
+  assert(_config.tokenArenaSize > 0);
+
+  _arenaMemory = std::make_unique<std::byte[]>(_config.maxTokens * _config.tokenArenaSize);
+  _tokens.reserve(_config.maxTokens);
+  _freeTokens.reserve(_config.maxTokens);
+
+  for (size_t i = 0; i < _config.maxTokens; ++i) {
+    std::span<std::byte> backing(_arenaMemory.get() + i * _config.tokenArenaSize, _config.tokenArenaSize);
+    auto slot = std::make_unique<TokenSlot>(backing);
+    slot->pipeline = this;
+    slot->token.arena = &slot->arena;
+    _freeTokens.push_back(slot.get());
+    _tokens.emplace_back(std::move(slot));
+  }
+}
+
+Pipeline::~Pipeline() {
+  wait();
+}
+
+void Pipeline::setSource(SourceFn fn, void* userData) {
+  assert(isFinished() && "Pipeline can't change while running");
+  _sourceFn = fn;
+  _sourceUserData = userData;
+}
+
+void Pipeline::addStage(StageMode mode, StageFn fn, void* userData) {
+  assert(isFinished() && "Pipeline can't change while running");
+  auto stage = std::make_unique<Stage>();
+  stage->mode = mode;
+  stage->fn = fn;
+  stage->userData = userData;
+  if (mode != StageMode::Parallel) {
+    stage->parked.assign(_config.maxTokens, nullptr);
+  }
+  _stages.emplace_back(std::move(stage));
+}
+
+void Pipeline::start() {
+  assert(_sourceFn && "Pipeline has no source");
+  assert(isFinished() && "Pipeline is already running");
+
+  for (auto& stage : _stages) {
+    stage->busy = false;
+    stage->nextSequence = 0;
+    stage->parkedHead = 0;
+    stage->parkedCount = 0;
+  }
+
+  {
+    std::lock_guard lock(_mutex);
+    _nextSequence = 0;
+    _inFlight = 0;
+    _sourceExhausted = false;
+    _sourceActive = true;
+  }
+  _finished.store(false, std::memory_order_release);
+
+  submitJob(&Pipeline::runSource, this);
+}
+
+void Pipeline::wait() {
+  while (!_finished.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+void Pipeline::run() {
+  start();
+  wait();
+}
+
+bool Pipeline::isFinished() const { return _finished.load(std::memory_order_acquire); }
+
+uint64_t Pipeline::itemCount() const {
+  std::lock_guard lock(_mutex);
+  return _nextSequence;
+}
+
+size_t Pipeline::maxTokens() const { return _config.maxTokens; }
+
+void Pipeline::submitJob(Job::JobFn fn, void* userData) {
+  Job job;
+  job.fn = fn;
+  job.userData = userData;
+  job.priority = _config.priority;
+  _system.submit(job);
+}
+
+// Only ever runs once at a time (_sourceActive), produces until it runs out of tokens or input
+void Pipeline::runSource(void* userData) {
+  auto& pipeline = *static_cast<Pipeline*>(userData);
+
+  while (true) {
+    TokenSlot* slot = nullptr;
+    {
+      std::lock_guard lock(pipeline._mutex);
+      if (pipeline._freeTokens.empty()) {
+        pipeline._sourceActive = false;
+        return;
+      }
+      slot = pipeline._freeTokens.back();
+      pipeline._freeTokens.pop_back();
+      slot->token.sequence = pipeline._nextSequence;
+    }
+
+    if (!pipeline._sourceFn(slot->token, pipeline._sourceUserData)) {
+      slot->arena.reset();
+      slot->token.data = nullptr;
+
+      bool finished = false;
+      {
+        std::lock_guard lock(pipeline._mutex);
+        pipeline._freeTokens.push_back(slot);
+        pipeline._sourceExhausted = true;
+        pipeline._sourceActive = false;
+        finished = pipeline._inFlight == 0;
+      }
+      // Last access, the pipeline may be destroyed as soon as wait() sees this
+      if (finished) pipeline._finished.store(true, std::memory_order_release);
+      return;
+    }
+
+    {
+      std::lock_guard lock(pipeline._mutex);
+      ++pipeline._nextSequence;
+      ++pipeline._inFlight;
+    }
+
+    slot->stage = 0;
+    slot->ownsStage = false;
+    pipeline.submitJob(&Pipeline::runToken, slot);
+  }
+}
+
+void Pipeline::runToken(void* userData) {
+  auto* slot = static_cast<TokenSlot*>(userData);
+  slot->pipeline->advance(*slot);
+}
+
+void Pipeline::advance(TokenSlot& slot) {
+  while (slot.stage < _stages.size()) {
+    Stage& stage = *_stages[slot.stage];
+
+    if (stage.mode == StageMode::Parallel) {
+      stage.fn(slot.token, stage.userData);
+      ++slot.stage;
+      continue;
+    }
+
+    // Parked tokens are resumed by whoever leaves the stage
+    if (!slot.ownsStage && !enterSerialStage(stage, slot)) {
+      return;
+    }
+    slot.ownsStage = false;
+
+    stage.fn(slot.token, stage.userData);
+
+    if (TokenSlot* next = leaveSerialStage(stage)) {
+      next->ownsStage = true;
+      submitJob(&Pipeline::runToken, next);
+    }
+    ++slot.stage;
+  }
+
+  releaseToken(slot);
+}
+
+bool Pipeline::enterSerialStage(Stage& stage, TokenSlot& slot) {
+  std::lock_guard lock(stage.mutex);
+  size_t capacity = stage.parked.size();
+
+  if (stage.mode == StageMode::SerialInOrder) {
+    if (!stage.busy && slot.token.sequence == stage.nextSequence) {
+      stage.busy = true;
+      return true;
+    }
+    // Every token from nextSequence on is still in flight, so at most
+    // maxTokens sequences can be waiting here and the slots never collide
+    TokenSlot*& parked = stage.parked[slot.token.sequence % capacity];
+    assert(!parked);
+    parked = &slot;
+    return false;
+  }
+
+  if (!stage.busy) {
+    stage.busy = true;
+    return true;
+  }
+  assert(stage.parkedCount < capacity);
+  stage.parked[(stage.parkedHead + stage.parkedCount) % capacity] = &slot;
+  ++stage.parkedCount;
+  return false;
+}
+
+// The stage stays busy when it's handed straight to a parked token
+Pipeline::TokenSlot* Pipeline::leaveSerialStage(Stage& stage) {
+  std::lock_guard lock(stage.mutex);
+  size_t capacity = stage.parked.size();
+  TokenSlot* next = nullptr;
+
+  if (stage.mode == StageMode::SerialInOrder) {
+    ++stage.nextSequence;
+    TokenSlot*& parked = stage.parked[stage.nextSequence % capacity];
+    if (parked) {
+      assert(parked->token.sequence == stage.nextSequence);
+      next = parked;
+      parked = nullptr;
+    }
+  } else if (stage.parkedCount > 0) {
+    next = stage.parked[stage.parkedHead];
+    stage.parkedHead = (stage.parkedHead + 1) % capacity;
+    --stage.parkedCount;
+  }
+
+  stage.busy = next != nullptr;
+  return next;
+}
+
+void Pipeline::releaseToken(TokenSlot& slot) {
+  slot.arena.reset();
+  slot.token.data = nullptr;
+
+  bool restartSource = false;
+  bool finished = false;
+  {
+    std::lock_guard lock(_mutex);
+    _freeTokens.push_back(&slot);
+    --_inFlight;
+
+    if (!_sourceExhausted && !_sourceActive) {
+      _sourceActive = true;
+      restartSource = true;
+    }
+    finished = _sourceExhausted && _inFlight == 0;
+  }
+
+  // Keep producing on this worker, the freed token is the one it'll pick up
+  if (restartSource) {
+    runSource(this);
+  } else if (finished) {
+    _finished.store(true, std::memory_order_release);
+  }
+}
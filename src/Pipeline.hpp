@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "FrameArena.hpp"
+#include "Job.hpp"
+
+class JobSystem;
+
+enum class StageMode : uint8_t {
+  SerialInOrder,     // One token at a time, in the order the source produced them
+  SerialOutOfOrder,  // One token at a time, in whatever order they arrive
+  Parallel           // Any number of tokens at once
+};
+
+//
+//  One item flowing through a Pipeline. `data` is free for the stages to
+//  use, typically pointing into `arena`. The arena is reset and `data`
+//  cleared when the token leaves the last stage, and the token is reused
+//  for a later item.
+//
+struct PipelineToken {
+  uint64_t sequence = 0;  // Position in the source's output, starts at 0 for every run
+  void* data = nullptr;
+  FrameArena* arena = nullptr;
+};
+
+struct PipelineConfig {
+  size_t maxTokens = 8;               // Items in flight at once, bounds memory use
+  size_t tokenArenaSize = 64 * 1024;  // Bytes of scratch per token
+  JobPriority priority = JobPriority::Normal;
+};
+
+//
+//  A stream of items pushed through a fixed sequence of stages, e.g.
+//  parse -> transform -> compress -> write, without building a graph per
+//  item. The source runs serially and stops producing once `maxTokens`
+//  items are in flight; a token is handed back to it when it leaves the
+//  last stage.
+//
+//  A token runs its stages back to back in one job until it reaches a
+//  serial stage that is busy (or, for SerialInOrder, waiting on an earlier
+//  token). It's parked there without holding a worker and resumed as a new
+//  job by the token that frees the stage.
+//
+//  The pipeline and everything its stages reference must stay alive until
+//  wait() returns. A pipeline can be run again once it finished.
+//
+class Pipeline {
+ public:
+  // Fill in the token and return true, or return false at the end of the input
+  using SourceFn = bool (*)(PipelineToken& token, void* userData);
+  using StageFn = void (*)(PipelineToken& token, void* userData);
+
+  Pipeline(JobSystem& system, const PipelineConfig& config = {});
+  ~Pipeline();
+
+  Pipeline(const Pipeline&) = delete;
+  Pipeline& operator=(const Pipeline&) = delete;
+
+  void setSource(SourceFn fn, void* userData);
+  void addStage(StageMode mode, StageFn fn, void* userData);
+
+  void start();
+  void wait();
+  void run();
+
+  bool isFinished() const;
+  uint64_t itemCount() const;  // Items produced by the source in the current run
+  size_t maxTokens() const;
+
+ private:
+  struct TokenSlot {
+    PipelineToken token;
+    FrameArena arena;
+    Pipeline* pipeline = nullptr;
+    size_t stage = 0;
+    bool ownsStage = false;  // Handed a serial stage by the token that left it
+
+    explicit TokenSlot(std::span<std::byte> backing) : arena(backing) {}
+  };
+
+  struct Stage {
+    StageMode mode = StageMode::Parallel;
+    StageFn fn = nullptr;
+    void* userData = nullptr;
+
+    // Serial stages only
+    std::mutex mutex;
+    bool busy = false;
+    uint64_t nextSequence = 0;       // SerialInOrder: next token allowed in
+    std::vector<TokenSlot*> parked;  // SerialInOrder: by sequence % maxTokens, otherwise a FIFO ring
+    size_t parkedHead = 0;
+    size_t parkedCount = 0;
+  };
+
+  static void runSource(void* userData);
+  static void runToken(void* userData);
+
+  void advance(TokenSlot& slot);
+  bool enterSerialStage(Stage& stage, TokenSlot& slot);
+  TokenSlot* leaveSerialStage(Stage& stage);
+  void releaseToken(TokenSlot& slot);
+  void submitJob(Job::JobFn fn, void* userData);
+
+  JobSystem& _system;
+  PipelineConfig _config;
+
+  SourceFn _sourceFn = nullptr;
+  void* _sourceUserData = nullptr;
+  std::vector<std::unique_ptr<Stage>> _stages;
+
+  std::unique_ptr<std::byte[]> _arenaMemory;
+  std::vector<std::unique_ptr<TokenSlot>> _tokens;
+
+  // Guards the free list and the source state
+  mutable std::mutex _mutex;
+  std::vector<TokenSlot*> _freeTokens;
+  bool _sourceActive = false;
+  bool _sourceExhausted = false;
+  uint64_t _nextSequence = 0;
+  size_t _inFlight = 0;
+
+  std::atomic<bool> _finished = true;
+};
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "FrameArena.hpp"
+#include "Job.hpp"
+#include "JobGraphNode.hpp"
+#include "JobSystem.hpp"
+
+//
+//  Node of a StaticJobGraph: a JobGraphNode type plus the input and output
+//  types it's run with. Out = void selects run(const In*, FrameArena*).
+//
+template <typename Node, typename In, typename Out = void>
+struct StaticNode {
+  using Type = Node;
+  using Input = In;
+  using Output = Out;
+};
+
+// `To` runs after `From` and reads From's output as its input
+template <size_t From, size_t To>
+struct StaticEdge {
+  static constexpr size_t from = From;
+  static constexpr size_t to = To;
+  static constexpr bool passesData = true;
+};
+
+// `To` runs after `From`, no data is passed
+template <size_t From, size_t To>
+struct StaticOrder {
+  static constexpr size_t from = From;
+  static constexpr size_t to = To;
+  static constexpr bool passesData = false;
+};
+
+template <typename... Nodes>
+struct StaticNodes {};
+
+template <typename... Edges>
+struct StaticEdges {};
+
+//
+//  Everything StaticJobGraph needs to know about its edges, computed at
+//  compile time. Successors are stored CSR style: node i's successors are
+//  successors[successorStart[i] .. successorStart[i + 1]).
+//
+template <size_t NodeCount, size_t EdgeCount>
+struct StaticGraphTopology {
+  static constexpr int32_t NoSource = -1;
+
+  std::array<uint32_t, NodeCount> inDegree{};
+  std::array<uint32_t, NodeCount + 1> successorStart{};
+  std::array<uint32_t, EdgeCount> successors{};
+  std::array<uint32_t, NodeCount> order{};      // Topological, valid when acyclic
+  std::array<int32_t, NodeCount> dataSource{};  // Node whose output feeds this node's input, or NoSource
+
+  bool edgesInRange = true;
+  bool noDuplicateEdges = true;
+  bool singleDataInput = true;  // At most one StaticEdge into every node
+  bool acyclic = true;
+};
+
+template <size_t NodeCount, size_t EdgeCount>
+constexpr StaticGraphTopology<NodeCount, EdgeCount> buildStaticGraphTopology(const std::array<size_t, EdgeCount>& from,
+                                                                              const std::array<size_t, EdgeCount>& to,
+                                                                              const std::array<bool, EdgeCount>& passesData) {
+  StaticGraphTopology<NodeCount, EdgeCount> topology;
+  topology.dataSource.fill(StaticGraphTopology<NodeCount, EdgeCount>::NoSource);
+
+  for (size_t e = 0; e < EdgeCount; ++e) {
+    if (from[e] >= NodeCount || to[e] >= NodeCount) {
+      topology.edgesInRange = false;
+      return topology;
+    }
+    for (size_t other = 0; other < e; ++other) {
+      if (from[other] == from[e] && to[other] == to[e]) topology.noDuplicateEdges = false;
+    }
+    ++topology.inDegree[to[e]];
+    ++topology.successorStart[from[e] + 1];
+    if (passesData[e]) {
+      if (topology.dataSource[to[e]] != StaticGraphTopology<NodeCount, EdgeCount>::NoSource) topology.singleDataInput = false;
+      topology.dataSource[to[e]] = static_cast<int32_t>(from[e]);
+    }
+  }
+
+  for (size_t i = 0; i < NodeCount; ++i) {
+    topology.successorStart[i + 1] += topology.successorStart[i];
+  }
+  std::array<uint32_t, NodeCount> cursor{};
+  for (size_t i = 0; i < NodeCount; ++i) {
+    cursor[i] = topology.successorStart[i];
+  }
+  for (size_t e = 0; e < EdgeCount; ++e) {
+    topology.successors[cursor[from[e]]++] = static_cast<uint32_t>(to[e]);
+  }
+
+  // Kahn's algorithm, every node is ordered exactly when there's no cycle
+  std::array<uint32_t, NodeCount> remaining = topology.inDegree;
+  size_t head = 0;
+  size_t tail = 0;
+  for (size_t i = 0; i < NodeCount; ++i) {
+    if (remaining[i] == 0) topology.order[tail++] = static_cast<uint32_t>(i);
+  }
+  while (head < tail) {
+    uint32_t node = topology.order[head++];
+    for (uint32_t e = topology.successorStart[node]; e < topology.successorStart[node + 1]; ++e) {
+      uint32_t next = topology.successors[e];
+      if (--remaining[next] == 0) topology.order[tail++] = next;
+    }
+  }
+  topology.acyclic = tail == NodeCount;
+
+  return topology;
+}
+
+template <typename NodeList, typename EdgeList>
+class StaticJobGraph;
+
+//
+//  A job graph whose topology is part of its type, for hot graphs that
+//  never change shape:
+//
+//      using FrameGraph = StaticJobGraph<
+//          StaticNodes<StaticNode<Animate, Scene, Poses>,    // 0
+//                      StaticNode<Skin, Poses, Meshes>,      // 1
+//                      StaticNode<Cull, Scene, Visible>,     // 2
+//                      StaticNode<Draw, Meshes>>,            // 3
+//          StaticEdges<StaticEdge<0, 1>, StaticEdge<1, 3>, StaticOrder<2, 3>>>;
+//
+//      FrameGraph graph(&system.frameArena());
+//      graph.setInput<0>(&scene);
+//      graph.setInput<2>(&scene);
+//      graph.submit(system);
+//      graph.wait();
+//
+//  Cycles, out of range or duplicate edges, nodes that don't match their
+//  declared types (IsJobGraphNode) and StaticEdges whose types don't line
+//  up are compile errors. In-degrees, successors and a topological order
+//  are constexpr arrays; nothing is built or allocated at runtime.
+//
+//  The graph owns every node's output. A StaticEdge binds the target's
+//  input to the source's output, other inputs are set with setInput().
+//
+//  run() calls every node directly in topological order on the calling
+//  thread. submit() runs nodes as jobs, each calling Node::run directly:
+//  a node whose only successor has no other dependency calls it right
+//  away, otherwise the first successor it makes ready runs next on the
+//  same worker and the rest are submitted. Nodes with a single dependency
+//  don't touch an atomic counter at all.
+//
+template <typename... Nodes, typename... Edges>
+class StaticJobGraph<StaticNodes<Nodes...>, StaticEdges<Edges...>> {
+ public:
+  static constexpr size_t NodeCount = sizeof...(Nodes);
+  static constexpr size_t EdgeCount = sizeof...(Edges);
+
+  template <size_t I>
+  using NodeAt = std::tuple_element_t<I, std::tuple<Nodes...>>;
+  template <size_t I>
+  using InputOf = typename NodeAt<I>::Input;
+  template <size_t I>
+  using OutputOf = typename NodeAt<I>::Output;
+
+  static constexpr StaticGraphTopology<NodeCount, EdgeCount> Topology =
+      buildStaticGraphTopology<NodeCount>(std::array<size_t, EdgeCount>{Edges::from...},
+                                          std::array<size_t, EdgeCount>{Edges::to...},
+                                          std::array<bool, EdgeCount>{Edges::passesData...});
+
+  static_assert(NodeCount > 0, "StaticJobGraph needs at least one node");
+  static_assert(Topology.edgesInRange, "Edge refers to a node index outside of the graph");
+  static_assert(Topology.noDuplicateEdges, "Duplicate edge");
+  static_assert(Topology.singleDataInput, "A node can only take its input from one StaticEdge");
+  static_assert(Topology.acyclic, "StaticJobGraph edges form a cycle");
+
+  explicit StaticJobGraph(FrameArena* arena) : _arena(arena) {
+    static_assert((nodeMatchesTypes<Nodes>() && ...), "Node doesn't satisfy IsJobGraphNode for its declared input/output");
+    static_assert((edgeMatchesTypes<Edges>() && ...), "StaticEdge source output doesn't match the target's input");
+  }
+
+  StaticJobGraph(const StaticJobGraph&) = delete;
+  StaticJobGraph& operator=(const StaticJobGraph&) = delete;
+
+  template <size_t I>
+  void setInput(const InputOf<I>* input) {
+    static_assert(Topology.dataSource[I] == StaticGraphTopology<NodeCount, EdgeCount>::NoSource,
+                  "Input is bound to a StaticEdge");
+    _inputs[I] = input;
+  }
+
+  template <size_t I>
+    requires(!std::is_void_v<OutputOf<I>>)
+  OutputOf<I>& output() {
+    return std::get<I>(_outputs);
+  }
+
+  // Every node, in topological order, on the calling thread
+  void run() {
+    [this]<size_t... Ks>(std::index_sequence<Ks...>) {
+      (invoke<Topology.order[Ks]>(), ...);
+    }(std::make_index_sequence<NodeCount>{});
+  }
+
+  void submit(JobSystem& system, JobPriority priority = JobPriority::Normal) {
+    assert(isComplete() && "StaticJobGraph submitted while a previous run is in flight");
+    _system = &system;
+    _priority = priority;
+
+    for (size_t i = 0; i < NodeCount; ++i) {
+      _inDegree[i].store(Topology.inDegree[i], std::memory_order_relaxed);
+    }
+    _remaining.store(NodeCount, std::memory_order_relaxed);
+    _control.state.store(JobState::Pending, std::memory_order_relaxed);
+    _control.reopenContinuations();
+
+    [this]<size_t... Is>(std::index_sequence<Is...>) {
+      ((Topology.inDegree[Is] == 0 ? submitNode<Is>() : void()), ...);
+    }(std::make_index_sequence<NodeCount>{});
+  }
+
+  // Completes once every node ran, usable with JobSystem::wait and then()
+  JobHandle handle() { return JobHandle{.control = &_control, .system = _system}; }
+
+  bool isComplete() const {
+    JobState state = _control.state.load(std::memory_order_acquire);
+    return state == JobState::Completed || state == JobState::Cancelled;
+  }
+
+  // Helps with queued jobs while waiting, so it's safe to call from a job
+  void wait() {
+    while (!isComplete()) {
+      if (!_system->runPendingJob()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+ private:
+  using Runner = void (StaticJobGraph::*)();
+
+  template <typename N>
+  using OutputStorage = std::conditional_t<std::is_void_v<typename N::Output>, std::monostate, typename N::Output>;
+
+  template <typename N>
+  static constexpr bool nodeMatchesTypes() {
+    if constexpr (std::is_void_v<typename N::Output>) {
+      return IsJobGraphNodeNoOutput<typename N::Type, typename N::Input>;
+    } else {
+      return IsJobGraphNodeWithOutput<typename N::Type, typename N::Input, typename N::Output>;
+    }
+  }
+
+  template <typename E>
+  static constexpr bool edgeMatchesTypes() {
+    if constexpr (!E::passesData || E::from >= NodeCount || E::to >= NodeCount) {
+      return true;
+    } else {
+      return std::is_same_v<OutputOf<E::from>, InputOf<E::to>> &&
+             IsJobGraphNode<typename NodeAt<E::to>::Type, OutputOf<E::from>, OutputOf<E::to>>;
+    }
+  }
+
+  template <size_t I>
+  const InputOf<I>* inputFor() {
+    constexpr int32_t source = Topology.dataSource[I];
+    if constexpr (source != StaticGraphTopology<NodeCount, EdgeCount>::NoSource) {
+      return &std::get<source>(_outputs);
+    } else {
+      assert(_inputs[I] && "Node input not set");
+      return static_cast<const InputOf<I>*>(_inputs[I]);
+    }
+  }
+
+  template <size_t I>
+  void invoke() {
+    using Node = typename NodeAt<I>::Type;
+    if constexpr (std::is_void_v<OutputOf<I>>) {
+      Node::run(inputFor<I>(), _arena);
+    } else {
+      Node::run(inputFor<I>(), &std::get<I>(_outputs), _arena);
+    }
+  }
+
+  template <size_t I>
+  static void nodeJob(void* userData) {
+    static_cast<StaticJobGraph*>(userData)->runNode<I>();
+  }
+
+  template <size_t I>
+  void submitNode() {
+    Job job;
+    job.fn = &StaticJobGraph::nodeJob<I>;
+    job.userData = this;
+    job.priority = _priority;
+    _system->submit(job);
+  }
+
+  template <size_t I>
+  void runNode() {
+    invoke<I>();
+
+    constexpr uint32_t first = Topology.successorStart[I];
+    constexpr uint32_t count = Topology.successorStart[I + 1] - first;
+
+    if constexpr (count == 1 && Topology.inDegree[Topology.successors[first]] == 1) {
+      // A link of a chain: nothing else can release the successor, call it straight away
+      nodeDone();
+      runNode<Topology.successors[first]>();
+    } else {
+      Runner next = nullptr;
+      [&]<size_t... Ks>(std::index_sequence<Ks...>) {
+        (release<Topology.successors[first + Ks]>(next), ...);
+      }(std::make_index_sequence<count>{});
+
+      nodeDone();
+      if (next) {
+        (this->*next)();
+      }
+    }
+  }
+
+  // Keeps the first successor that became ready for this worker, submits the others
+  template <size_t S>
+  void release(Runner& next) {
+    if constexpr (Topology.inDegree[S] > 1) {
+      if (_inDegree[S].fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    }
+    if (!next) {
+      next = &StaticJobGraph::runNode<S>;
+    } else {
+      submitNode<S>();
+    }
+  }
+
+  void nodeDone() {
+    if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      _system->finish(_control, JobState::Completed);
+    }
+  }
+
+  FrameArena* _arena = nullptr;
+  JobSystem* _system = nullptr;
+  JobPriority _priority = JobPriority::Normal;
+
+  std::tuple<OutputStorage<Nodes>...> _outputs;
+  std::array<const void*, NodeCount> _inputs{};
+
+  std::array<std::atomic<uint32_t>, NodeCount> _inDegree{};
+  std::atomic<size_t> _remaining = 0;
+  JobControlBlock _control{.state = JobState::Completed};
+};
@@ -0,0 +1,36 @@
+#include "ThreadAffinity.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+bool ThreadAffinity::pinCurrentThread(std::span<const uint32_t> cpus) {
+  if (cpus.empty()) return false;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (uint32_t cpu : cpus) {
+    if (cpu >= CPU_SETSIZE) return false;
+    CPU_SET(cpu, &set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool ThreadAffinity::pinCurrentThread(uint32_t cpu) {
+  return pinCurrentThread(std::span<const uint32_t>(&cpu, 1));
+}
+
+bool ThreadAffinity::setCurrentThreadName(std::string_view name) {
+  // Linux limits thread names to 15 characters + null terminator
+  char buffer[16] = {};
+  std::memcpy(buffer, name.data(), std::min(name.size(), sizeof(buffer) - 1));
+  return pthread_setname_np(pthread_self(), buffer) == 0;
+}
+
+uint32_t ThreadAffinity::hardwareThreadCount() {
+  uint32_t count = std::thread::hardware_concurrency();
+  return count == 0 ? 1 : count;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+//
+//  Thin wrappers around the pthread affinity/naming calls so the
+//  rest of the job system doesn't include <pthread.h> directly.
+//
+//  All of these act on the calling thread and return false when the
+//  OS rejects the request (e.g. a CPU id that doesn't exist on this
+//  machine). Callers treat that as "run unpinned" rather than an error.
+//
+class ThreadAffinity {
+ public:
+  static bool pinCurrentThread(std::span<const uint32_t> cpus);
+  static bool pinCurrentThread(uint32_t cpu);
+  static bool setCurrentThreadName(std::string_view name);
+  static uint32_t hardwareThreadCount();
+};
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <thread>
@@ -31,6 +32,11 @@ struct CombineNode : JobGraphNode<std::pair<int, int>> {
   }
 };
 
+// Cheap enough to be fused into a chain
+struct IncrementNode : JobGraphNode<int, int> {
+  static void run(const int* input, int* output, FrameArena*) { *output = *input + 1; }
+};
+
 int main() {
   std::cout << "Launching JobSystem...\n";
 
@@ -69,4 +75,37 @@ int main() {
   system.wait(nodeCombine.jobHandle);
 
   std::cout << "All jobs complete.\n";
+
+  // A fused chain whose head is cancelled: every member still finishes
+  // (cancelled) and the graph completes. Then run it again uncancelled.
+  auto chainGraph = system.createGraph(MemoryClass::Frame);
+  int chainValues[4] = {1, 0, 0, 0};
+  auto head = chainGraph.addNode<IncrementNode>(&chainValues[0], &chainValues[1]);
+  auto middle = chainGraph.addNode<IncrementNode>(&chainValues[1], &chainValues[2]);
+  auto tail = chainGraph.addNode<IncrementNode>(&chainValues[2], &chainValues[3]);
+  chainGraph.setDependencies(middle, {head});
+  chainGraph.setDependencies(tail, {middle});
+
+  std::atomic<bool> chainDone = false;
+  chainGraph.setOnGraphComplete([](GraphNodeHandle, void* userData) {
+    static_cast<std::atomic<bool>*>(userData)->store(true);
+  },
+                                &chainDone);
+  auto waitForChain = [&chainDone]() {
+    while (!chainDone.exchange(false)) {
+      std::this_thread::yield();
+    }
+  };
+
+  size_t links = chainGraph.fuseChains();
+  chainGraph.cancel(head);
+  system.submitGraph(chainGraph);
+  waitForChain();
+  bool tailCancelled = tail.jobHandle.control->state.load() == JobState::Cancelled;
+  std::cout << "Fused chain (" << links << " links) cancelled at its head, tail "
+            << (tailCancelled && chainValues[3] == 0 ? "skipped" : "ran!") << "\n";
+
+  system.submitGraph(chainGraph);
+  waitForChain();
+  std::cout << "Fused chain re-run: " << chainValues[0] << " -> " << chainValues[3] << "\n";
 }
\ No newline at end of file